@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Envoy {
+
+/**
+ * Counts heap allocations (malloc, new and friends) made by the calling
+ * thread, via tcmalloc's new hook. For benchmarks and allocation tests;
+ * the hook is installed when this library is linked in.
+ */
+class AllocCounter {
+public:
+  // allocations made by this thread so far
+  static uint64_t count();
+};
+
+} // Envoy
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/router/mocks.h"
+
+namespace Envoy {
+
+/**
+ * Decoder filter callbacks whose route lookup answers like the
+ * connection manager's, from a route held here, rather than through
+ * gmock. A gmock call allocates and takes gmock's global mutex, which
+ * would be counted against the filter by allocation tests and serialize
+ * the threads of the worker scaling benchmarks. Every other method is
+ * the usual NiceMock.
+ */
+class AllocFreeRouteEntry : public testing::NiceMock<Router::MockRouteEntry> {
+public:
+  const std::multimap<std::string, std::string>& opaqueConfig() const override { return opaque_; }
+
+  std::multimap<std::string, std::string> opaque_;
+};
+
+class AllocFreeRoute : public testing::NiceMock<Router::MockRoute> {
+public:
+  const Router::RouteEntry* routeEntry() const override { return &entry_; }
+
+  AllocFreeRouteEntry entry_;
+};
+
+class AllocFreeDecoderFilterCallbacks : public testing::NiceMock<Http::MockStreamDecoderFilterCallbacks> {
+public:
+  Router::RouteConstSharedPtr route() override { return alloc_free_route_; }
+
+  std::shared_ptr<AllocFreeRoute> alloc_free_route_{new AllocFreeRoute()};
+};
+
+} // Envoy
@@ -1,6 +1,7 @@
 #include "echo2.h"
 
 #include "envoy/buffer/buffer.h"
+#include "envoy/event/dispatcher.h"
 #include "envoy/network/connection.h"
 
 #include "common/common/assert.h"
@@ -8,12 +9,115 @@
 namespace Envoy {
 namespace Filter {
 
+Echo2Config::Echo2Config(Mode mode, uint64_t coalesce_bytes, std::chrono::milliseconds coalesce_timeout,
+                         uint64_t response_bytes, Stats::Scope& scope, const std::string& stats_prefix)
+    : mode_(mode), coalesce_bytes_(coalesce_bytes), coalesce_timeout_(coalesce_timeout),
+      response_(new std::string(mode == Mode::Source ? response_bytes : 0, 'x')), scope_(scope),
+      read_size_(stats_prefix + "read_size"), reads_per_cx_(stats_prefix + "reads_per_cx"),
+      read_to_flush_us_(stats_prefix + "read_to_flush_us"),
+      stats_{ALL_ECHO2_STATS(POOL_COUNTER_PREFIX(scope, stats_prefix), POOL_GAUGE_PREFIX(scope, stats_prefix))} {}
+
+void Echo2Config::addResponse(Buffer::Instance& buffer) const {
+  // the fragment keeps the payload alive until the buffer has been drained
+  std::shared_ptr<const std::string> response = response_;
+  buffer.addBufferFragment(*new Buffer::BufferFragmentImpl(
+      response->data(), response->size(),
+      [response](const void*, size_t, const Buffer::BufferFragmentImpl* fragment) -> void { delete fragment; }));
+}
+
+void Echo2::initializeReadFilterCallbacks(Network::ReadFilterCallbacks& callbacks) {
+  read_callbacks_ = &callbacks;
+  read_callbacks_->connection().addConnectionCallbacks(*this);
+  config_->stats().cx_total_.inc();
+  config_->stats().cx_active_.inc();
+  if (config_->coalesce_bytes() > 0 && config_->mode() != Echo2Config::Mode::Sink) {
+    flush_timer_ = read_callbacks_->connection().dispatcher().createTimer([this]() -> void { flush(); });
+  }
+}
+
 Network::FilterStatus Echo2::onData(Buffer::Instance& data) {
   ENVOY_CONN_LOG(trace, "echo: got {} bytes", read_callbacks_->connection(), data.length());
-  read_callbacks_->connection().write(data);
+  const MonotonicTime read_time = std::chrono::steady_clock::now();
+  reads_++;
+  config_->stats().reads_.inc();
+  config_->stats().rx_bytes_.add(data.length());
+  config_->recordReadSize(data.length());
+
+  switch (config_->mode()) {
+  case Echo2Config::Mode::Echo:
+    write(data, read_time);
+    break;
+  case Echo2Config::Mode::Sink:
+    config_->stats().sink_bytes_.add(data.length());
+    data.drain(data.length());
+    break;
+  case Echo2Config::Mode::Source: {
+    data.drain(data.length());
+    Buffer::OwnedImpl response;
+    config_->addResponse(response);
+    config_->stats().source_responses_.inc();
+    write(response, read_time);
+    break;
+  }
+  }
   ASSERT(0 == data.length());
   return Network::FilterStatus::StopIteration;
 }
 
+void Echo2::write(Buffer::Instance& data, MonotonicTime read_time) {
+  if (config_->coalesce_bytes() == 0) {
+    config_->stats().tx_bytes_.add(data.length());
+    read_callbacks_->connection().write(data);
+    config_->recordReadToFlush(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - read_time));
+    return;
+  }
+
+  const bool was_empty = pending_.length() == 0;
+  if (was_empty) {
+    pending_since_ = read_time;
+  }
+  pending_.move(data);
+  if (pending_.length() >= config_->coalesce_bytes()) {
+    flush();
+  } else if (was_empty) {
+    flush_timer_->enableTimer(config_->coalesce_timeout());
+  }
+}
+
+void Echo2::flush() {
+  flush_timer_->disableTimer();
+  if (pending_.length() > 0) {
+    ENVOY_CONN_LOG(trace, "echo: flushing {} bytes", read_callbacks_->connection(), pending_.length());
+    config_->stats().tx_bytes_.add(pending_.length());
+    read_callbacks_->connection().write(pending_);
+    config_->recordReadToFlush(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - pending_since_));
+  }
+}
+
+void Echo2::onEvent(Network::ConnectionEvent event) {
+  if (closed_ ||
+      (event != Network::ConnectionEvent::RemoteClose && event != Network::ConnectionEvent::LocalClose)) {
+    return;
+  }
+  closed_ = true;
+  if (flush_timer_) {
+    flush_timer_->disableTimer();
+  }
+  config_->stats().cx_active_.dec();
+  config_->recordReadsPerConnection(reads_);
+}
+
+void Echo2::onAboveWriteBufferHighWatermark() {
+  ENVOY_CONN_LOG(debug, "echo: write buffer full, disabling reads", read_callbacks_->connection());
+  read_callbacks_->connection().readDisable(true);
+}
+
+void Echo2::onBelowWriteBufferLowWatermark() {
+  ENVOY_CONN_LOG(debug, "echo: write buffer drained, enabling reads", read_callbacks_->connection());
+  read_callbacks_->connection().readDisable(false);
+}
+
 } // Filter
 } // Envoy
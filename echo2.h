@@ -1,26 +1,133 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/common/time.h"
+#include "envoy/event/timer.h"
+#include "envoy/network/connection.h"
 #include "envoy/network/filter.h"
+#include "envoy/stats/stats_macros.h"
 
+#include "common/buffer/buffer_impl.h"
 #include "common/common/logger.h"
 
 namespace Envoy {
 namespace Filter {
 
 /**
- * Implementation of a basic echo filter.
+ * All echo2 stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_ECHO2_STATS(COUNTER, GAUGE)                                                           \
+  COUNTER(cx_total)                                                                               \
+  COUNTER(rx_bytes)                                                                               \
+  COUNTER(tx_bytes)                                                                               \
+  COUNTER(reads)                                                                                  \
+  COUNTER(sink_bytes)                                                                             \
+  COUNTER(source_responses)                                                                       \
+  GAUGE  (cx_active)
+// clang-format on
+
+/**
+ * Struct definition for all echo2 stats. @see stats_macros.h
  */
-class Echo2 : public Network::ReadFilter, Logger::Loggable<Logger::Id::filter> {
+struct Echo2Stats {
+  ALL_ECHO2_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
+};
+
+/**
+ * Configuration for the echo2 filter, shared by all its connections.
+ */
+class Echo2Config {
 public:
+  enum class Mode {
+    // write back what is read
+    Echo,
+    // discard what is read, counting it
+    Sink,
+    // answer each read with response_bytes bytes
+    Source
+  };
+
+  Echo2Config(Mode mode, uint64_t coalesce_bytes, std::chrono::milliseconds coalesce_timeout,
+              uint64_t response_bytes, Stats::Scope& scope, const std::string& stats_prefix);
+
+  Mode mode() const { return mode_; }
+  // written bytes are held until this many are pending; 0 writes each
+  // read's reply as it arrives
+  uint64_t coalesce_bytes() const { return coalesce_bytes_; }
+  // or until this long after the first of them was held
+  std::chrono::milliseconds coalesce_timeout() const { return coalesce_timeout_; }
+  Echo2Stats& stats() const { return stats_; }
+
+  // histograms, delivered straight to the stats sinks
+  void recordReadSize(uint64_t bytes) const { scope_.deliverHistogramToSinks(read_size_, bytes); }
+  void recordReadsPerConnection(uint64_t reads) const { scope_.deliverHistogramToSinks(reads_per_cx_, reads); }
+  void recordReadToFlush(std::chrono::microseconds time) const {
+    scope_.deliverHistogramToSinks(read_to_flush_us_, time.count());
+  }
+
+  // append a source mode response to buffer; the bytes reference one
+  // payload shared by every response rather than being copied
+  void addResponse(Buffer::Instance& buffer) const;
+
+private:
+  const Mode mode_;
+  const uint64_t coalesce_bytes_;
+  const std::chrono::milliseconds coalesce_timeout_;
+  const std::shared_ptr<const std::string> response_;
+  Stats::Scope& scope_;
+  const std::string read_size_;
+  const std::string reads_per_cx_;
+  const std::string read_to_flush_us_;
+  mutable Echo2Stats stats_;
+};
+
+typedef std::shared_ptr<const Echo2Config> Echo2ConfigConstSharedPtr;
+
+/**
+ * Implementation of a basic echo filter, which can also sink or source
+ * traffic for L4 throughput benchmarks. Reading stops while the
+ * connection's write buffer is above its high watermark (set by the
+ * listener's per_connection_buffer_limit_bytes), so a peer that does not
+ * read cannot grow the buffer without bound.
+ *
+ * With coalescing on, the replies to small reads are gathered into one
+ * write, the way chatty services batch their replies.
+ */
+class Echo2 : public Network::ReadFilter,
+              public Network::ConnectionCallbacks,
+              Logger::Loggable<Logger::Id::filter> {
+public:
+  Echo2(Echo2ConfigConstSharedPtr config) : config_(config) {}
+
   // Network::ReadFilter
   Network::FilterStatus onData(Buffer::Instance& data) override;
   Network::FilterStatus onNewConnection() override { return Network::FilterStatus::Continue; }
-  void initializeReadFilterCallbacks(Network::ReadFilterCallbacks& callbacks) override {
-    read_callbacks_ = &callbacks;
-  }
+  void initializeReadFilterCallbacks(Network::ReadFilterCallbacks& callbacks) override;
+
+  // Network::ConnectionCallbacks
+  void onEvent(Network::ConnectionEvent event) override;
+  void onAboveWriteBufferHighWatermark() override;
+  void onBelowWriteBufferLowWatermark() override;
 
 private:
+  void write(Buffer::Instance& data, MonotonicTime read_time);
+  void flush();
+
+  Echo2ConfigConstSharedPtr config_;
   Network::ReadFilterCallbacks* read_callbacks_{};
+  // coalesced bytes not yet echoed, and the timer that flushes them
+  Buffer::OwnedImpl pending_;
+  Event::TimerPtr flush_timer_;
+  // when the oldest read in pending_ arrived
+  MonotonicTime pending_since_;
+  uint64_t reads_{};
+  bool closed_{};
 };
 
 } // Filter
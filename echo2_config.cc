@@ -9,15 +9,59 @@ namespace Envoy {
 namespace Server {
 namespace Configuration {
 
+const std::string ECHO2_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "description": "JSON object to configure an instance of the echo2 network filter",
+    "additionalProperties": false,
+    "properties":{
+      "mode" : {
+        "type" : "string",
+        "enum" : ["echo", "sink", "source"],
+        "description": "echo writes back what is read, sink discards it, source answers each read with response_bytes bytes. Defaults to echo."
+      },
+      "response_bytes" : {
+        "type" : "integer",
+        "minimum" : 1,
+        "description": "size of each source mode response. Defaults to 1024."
+      },
+      "stat_prefix" : {
+        "type" : "string",
+        "description": "stats are rooted at echo2.<stat_prefix>. Defaults to none, rooting them at echo2."
+      },
+      "coalesce_bytes" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "description": "hold written bytes until this many are pending. Defaults to 0, echoing each read at once."
+      },
+      "coalesce_timeout_ms" : {
+        "type" : "integer",
+        "minimum" : 1,
+        "description": "flush held bytes this long after the first was held, if coalesce_bytes is not reached first. Defaults to 1."
+      }
+    }
+  }
+)EOF");
+
 /**
  * Config registration for the echo2 filter. @see NamedNetworkFilterConfigFactory.
  */
 class Echo2ConfigFactory : public NamedNetworkFilterConfigFactory {
 public:
   // NamedNetworkFilterConfigFactory
-  NetworkFilterFactoryCb createFilterFactory(const Json::Object&, FactoryContext&) override {
-    return [](Network::FilterManager& filter_manager)
-        -> void { filter_manager.addReadFilter(Network::ReadFilterSharedPtr{new Filter::Echo2()}); };
+  NetworkFilterFactoryCb createFilterFactory(const Json::Object& json_config, FactoryContext& context) override {
+    json_config.validateSchema(ECHO2_SCHEMA);
+    const std::string mode = json_config.getString("mode", "echo");
+    Filter::Echo2ConfigConstSharedPtr config(new Filter::Echo2Config(
+        mode == "sink" ? Filter::Echo2Config::Mode::Sink
+                       : mode == "source" ? Filter::Echo2Config::Mode::Source : Filter::Echo2Config::Mode::Echo,
+        json_config.getInteger("coalesce_bytes", 0),
+        std::chrono::milliseconds(json_config.getInteger("coalesce_timeout_ms", 1)),
+        json_config.getInteger("response_bytes", 1024), context.scope(),
+        json_config.hasObject("stat_prefix") ? "echo2." + json_config.getString("stat_prefix") + "." : "echo2."));
+    return [config](Network::FilterManager& filter_manager)
+        -> void { filter_manager.addReadFilter(Network::ReadFilterSharedPtr{new Filter::Echo2(config)}); };
   }
 
   std::string name() override { return "echo2"; }
@@ -10,7 +10,7 @@ public:
    * Initializer for an individual integration test.
    */
   void SetUp() override {
-    createTestServer("echo2_server.json", {"echo"});
+    createTestServer("echo2_server.json", {"echo", "echo_coalesce", "source"});
   }
 
   /**
@@ -37,4 +37,54 @@ TEST_P(Echo2IntegrationTest, Echo) {
   connection.run();
   EXPECT_EQ("hello", response);
 }
+
+// below coalesce_bytes, so flushed by the timer
+TEST_P(Echo2IntegrationTest, EchoCoalesced) {
+  Buffer::OwnedImpl buffer("hello");
+  std::string response;
+  RawConnectionDriver connection(lookupPort("echo_coalesce"), buffer,
+                                 [&](Network::ClientConnection&, const Buffer::Instance& data)
+                                     -> void {
+                                       response.append(TestUtility::bufferToString(data));
+                                       connection.close();
+                                     }, GetParam());
+
+  connection.run();
+  EXPECT_EQ("hello", response);
+}
+
+TEST_P(Echo2IntegrationTest, Source) {
+  Buffer::OwnedImpl buffer("hello");
+  std::string response;
+  RawConnectionDriver connection(lookupPort("source"), buffer,
+                                 [&](Network::ClientConnection&, const Buffer::Instance& data)
+                                     -> void {
+                                       response.append(TestUtility::bufferToString(data));
+                                       if (response.size() == 100) {
+                                         connection.close();
+                                       }
+                                     }, GetParam());
+
+  connection.run();
+  EXPECT_EQ(std::string(100, 'x'), response);
+}
+
+// more than the listener's buffer limit, so echo2 pauses and resumes
+// reading as the client drains the echoed data
+TEST_P(Echo2IntegrationTest, EchoPastBufferLimit) {
+  const std::string request(1024 * 1024, 'a');
+  Buffer::OwnedImpl buffer(request);
+  std::string response;
+  RawConnectionDriver connection(lookupPort("echo"), buffer,
+                                 [&](Network::ClientConnection&, const Buffer::Instance& data)
+                                     -> void {
+                                       response.append(TestUtility::bufferToString(data));
+                                       if (response.size() == request.size()) {
+                                         connection.close();
+                                       }
+                                     }, GetParam());
+
+  connection.run();
+  EXPECT_EQ(request, response);
+}
 } // Envoy
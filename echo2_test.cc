@@ -0,0 +1,186 @@
+#include <memory>
+#include <string>
+
+#include "echo2.h"
+#include "common/buffer/buffer_impl.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/network/mocks.h"
+#include "test/mocks/stats/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::_;
+
+namespace Filter {
+
+class Echo2Test : public testing::Test {
+public:
+  Echo2Test() {
+    ON_CALL(read_callbacks_.connection_, readDisable(_)).WillByDefault(Invoke([this](bool disable) -> void {
+      read_enabled_ = !disable;
+    }));
+    // a write buffer the peer never reads, with the connection's watermark
+    ON_CALL(read_callbacks_.connection_, write(_)).WillByDefault(Invoke([this](Buffer::Instance& data) -> void {
+      writes_++;
+      bool was_below = unread_.length() <= LIMIT;
+      unread_.move(data);
+      if (was_below && unread_.length() > LIMIT) {
+        for (Network::ConnectionCallbacks* callbacks : read_callbacks_.connection_.callbacks_) {
+          callbacks->onAboveWriteBufferHighWatermark();
+        }
+      }
+    }));
+  }
+
+  void setup(uint64_t coalesce_bytes = 0, Echo2Config::Mode mode = Echo2Config::Mode::Echo) {
+    if (coalesce_bytes > 0) {
+      flush_timer_ = new NiceMock<Event::MockTimer>(&read_callbacks_.connection_.dispatcher_);
+    }
+    filter_.reset(new Echo2(Echo2ConfigConstSharedPtr{
+        new Echo2Config(mode, coalesce_bytes, std::chrono::milliseconds(5), 100, stats_store_, "echo2.")}));
+    filter_->initializeReadFilterCallbacks(read_callbacks_);
+  }
+
+  void drainUnread() {
+    unread_.drain(unread_.length());
+    for (Network::ConnectionCallbacks* callbacks : read_callbacks_.connection_.callbacks_) {
+      callbacks->onBelowWriteBufferLowWatermark();
+    }
+  }
+
+  static const uint64_t LIMIT = 16384;
+  static const uint64_t CHUNK = 4096;
+
+  NiceMock<Stats::MockIsolatedStatsStore> stats_store_;
+  NiceMock<Network::MockReadFilterCallbacks> read_callbacks_;
+  Event::MockTimer* flush_timer_{};
+  std::unique_ptr<Echo2> filter_;
+  Buffer::OwnedImpl unread_;
+  uint64_t writes_{};
+  bool read_enabled_{true};
+};
+
+TEST_F(Echo2Test, Echo) {
+  setup();
+  Buffer::OwnedImpl data("hello");
+  EXPECT_EQ(Network::FilterStatus::StopIteration, filter_->onData(data));
+  EXPECT_EQ(0U, data.length());
+  EXPECT_EQ("hello", TestUtility::bufferToString(unread_));
+}
+
+TEST_F(Echo2Test, StalledReaderBoundsWriteBuffer) {
+  setup();
+  // the peer sends 10MB and reads nothing; the connection only delivers
+  // reads while they are enabled
+  uint64_t sent = 0;
+  while (read_enabled_ && sent < 10 * 1024 * 1024) {
+    Buffer::OwnedImpl chunk(std::string(CHUNK, 'a'));
+    filter_->onData(chunk);
+    sent += CHUNK;
+  }
+  EXPECT_FALSE(read_enabled_);
+  EXPECT_LE(unread_.length(), LIMIT + CHUNK);
+  EXPECT_EQ(sent, unread_.length());
+
+  drainUnread();
+  EXPECT_TRUE(read_enabled_);
+}
+
+TEST_F(Echo2Test, CoalesceFlushesAtThreshold) {
+  setup(10);
+  EXPECT_CALL(*flush_timer_, enableTimer(std::chrono::milliseconds(5))).Times(1);
+  Buffer::OwnedImpl data("hello");
+  filter_->onData(data);
+  EXPECT_EQ(0U, data.length());
+  EXPECT_EQ(0U, writes_);
+
+  EXPECT_CALL(*flush_timer_, disableTimer());
+  Buffer::OwnedImpl more("world");
+  filter_->onData(more);
+  EXPECT_EQ(1U, writes_);
+  EXPECT_EQ("helloworld", TestUtility::bufferToString(unread_));
+}
+
+TEST_F(Echo2Test, CoalesceFlushesOnTimer) {
+  setup(10);
+  EXPECT_CALL(*flush_timer_, enableTimer(_)).Times(1);
+  Buffer::OwnedImpl data("hel");
+  filter_->onData(data);
+  Buffer::OwnedImpl more("lo");
+  filter_->onData(more);
+  EXPECT_EQ(0U, writes_);
+
+  flush_timer_->callback_();
+  EXPECT_EQ(1U, writes_);
+  EXPECT_EQ("hello", TestUtility::bufferToString(unread_));
+
+  // a timer firing with nothing pending writes nothing
+  flush_timer_->callback_();
+  EXPECT_EQ(1U, writes_);
+}
+
+TEST_F(Echo2Test, CoalesceTimerStopsOnClose) {
+  setup(10);
+  Buffer::OwnedImpl data("hello");
+  filter_->onData(data);
+  EXPECT_CALL(*flush_timer_, disableTimer());
+  filter_->onEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_EQ(0U, writes_);
+}
+
+TEST_F(Echo2Test, Stats) {
+  EXPECT_CALL(stats_store_, deliverHistogramToSinks("echo2.read_size", 5)).Times(2);
+  EXPECT_CALL(stats_store_, deliverHistogramToSinks("echo2.read_to_flush_us", _)).Times(1);
+  setup(10);
+  EXPECT_EQ(1U, stats_store_.counter("echo2.cx_total").value());
+  EXPECT_EQ(1U, stats_store_.gauge("echo2.cx_active").value());
+
+  Buffer::OwnedImpl data("hello");
+  filter_->onData(data);
+  Buffer::OwnedImpl more("world");
+  filter_->onData(more);
+  EXPECT_EQ(2U, stats_store_.counter("echo2.reads").value());
+  EXPECT_EQ(10U, stats_store_.counter("echo2.rx_bytes").value());
+  EXPECT_EQ(10U, stats_store_.counter("echo2.tx_bytes").value());
+
+  EXPECT_CALL(stats_store_, deliverHistogramToSinks("echo2.reads_per_cx", 2));
+  filter_->onEvent(Network::ConnectionEvent::RemoteClose);
+  filter_->onEvent(Network::ConnectionEvent::LocalClose);
+  EXPECT_EQ(0U, stats_store_.gauge("echo2.cx_active").value());
+}
+
+TEST_F(Echo2Test, Sink) {
+  setup(0, Echo2Config::Mode::Sink);
+  Buffer::OwnedImpl data("hello");
+  EXPECT_EQ(Network::FilterStatus::StopIteration, filter_->onData(data));
+  EXPECT_EQ(0U, data.length());
+  EXPECT_EQ(0U, writes_);
+  EXPECT_EQ(5U, stats_store_.counter("echo2.sink_bytes").value());
+}
+
+TEST_F(Echo2Test, SourceSharesOnePayload) {
+  setup(0, Echo2Config::Mode::Source);
+  Buffer::OwnedImpl data("hello");
+  filter_->onData(data);
+  Buffer::OwnedImpl more("world");
+  filter_->onData(more);
+  EXPECT_EQ(0U, data.length());
+  EXPECT_EQ(2U, writes_);
+  EXPECT_EQ(std::string(200, 'x'), TestUtility::bufferToString(unread_));
+  EXPECT_EQ(2U, stats_store_.counter("echo2.source_responses").value());
+
+  // both responses point at the same bytes
+  Buffer::RawSlice slices[2];
+  ASSERT_EQ(2U, unread_.getRawSlices(slices, 2));
+  EXPECT_EQ(slices[0].mem_, slices[1].mem_);
+}
+
+} // Filter
+} // Envoy
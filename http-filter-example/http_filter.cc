@@ -7,25 +7,43 @@
 namespace Envoy {
 namespace Http {
 
-HttpSampleDecoderFilter::HttpSampleDecoderFilter() {}
+HttpSampleDecoderFilterConfig::HttpSampleDecoderFilterConfig(const Json::Object& json_config) {
+  if (!json_config.hasObject("headers")) {
+    // the original sample behaviour
+    mutations_.push_back({HeaderMutation::Op::Add, LowerCaseString("via"), "sample-filter"});
+    return;
+  }
+  for (const Json::ObjectSharedPtr& header : json_config.getObjectArray("headers")) {
+    const std::string op = header->getString("op", "add");
+    mutations_.push_back({op == "set" ? HeaderMutation::Op::Set
+                                      : op == "remove" ? HeaderMutation::Op::Remove : HeaderMutation::Op::Add,
+                          LowerCaseString(header->getString("key")), header->getString("value", "")});
+  }
+}
+
+HttpSampleDecoderFilter::HttpSampleDecoderFilter(HttpSampleDecoderFilterConfigConstSharedPtr config)
+    : config_(config) {}
 
 HttpSampleDecoderFilter::~HttpSampleDecoderFilter() {}
 
 void HttpSampleDecoderFilter::onDestroy() {}
 
-const LowerCaseString& HttpSampleDecoderFilter::headerKey() {
-  static LowerCaseString* key = new LowerCaseString("via");
-  return *key;
-}
-
-const std::string& HttpSampleDecoderFilter::headerValue() {
-  static std::string* val = new std::string("sample-filter");
-  return *val;
-}
-
 FilterHeadersStatus HttpSampleDecoderFilter::decodeHeaders(HeaderMap& headers, bool) {
-  // add a header
-  headers.addReference(headerKey(), headerValue());
+  // keys and values are referenced from the config, nothing is copied
+  for (const HeaderMutation& mutation : config_->mutations()) {
+    switch (mutation.op_) {
+    case HeaderMutation::Op::Set:
+      headers.remove(mutation.key_);
+      headers.addReference(mutation.key_, mutation.value_);
+      break;
+    case HeaderMutation::Op::Remove:
+      headers.remove(mutation.key_);
+      break;
+    case HeaderMutation::Op::Add:
+      headers.addReference(mutation.key_, mutation.value_);
+      break;
+    }
+  }
 
   return FilterHeadersStatus::Continue;
 }
@@ -1,15 +1,46 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "server/config/network/http_connection_manager.h"
 
 namespace Envoy {
 namespace Http {
 
+/**
+ * One header operation: add appends a value, set replaces any values,
+ * remove drops all values.
+ */
+struct HeaderMutation {
+  enum class Op { Add, Set, Remove };
+
+  Op op_;
+  LowerCaseString key_;
+  std::string value_;
+};
+
+/**
+ * The header operations, compiled once from the filter config and shared
+ * read only by every stream. Filters add keys and values by reference, so
+ * the config must outlive them.
+ */
+class HttpSampleDecoderFilterConfig {
+public:
+  HttpSampleDecoderFilterConfig(const Json::Object& json_config);
+
+  const std::vector<HeaderMutation>& mutations() const { return mutations_; }
+
+private:
+  std::vector<HeaderMutation> mutations_;
+};
+
+typedef std::shared_ptr<const HttpSampleDecoderFilterConfig> HttpSampleDecoderFilterConfigConstSharedPtr;
+
 class HttpSampleDecoderFilter : public StreamDecoderFilter {
 public:
-  HttpSampleDecoderFilter();
+  HttpSampleDecoderFilter(HttpSampleDecoderFilterConfigConstSharedPtr config);
   ~HttpSampleDecoderFilter();
 
   // Http::StreamFilterBase
@@ -22,11 +53,9 @@ public:
   void setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) override;
 
 private:
-  StreamDecoderFilterCallbacks* decoder_callbacks_;
-
-  const LowerCaseString& headerKey();
-  const std::string& headerValue();
+  const HttpSampleDecoderFilterConfigConstSharedPtr config_;
+  StreamDecoderFilterCallbacks* decoder_callbacks_{};
 };
 
 } // Http
-} // Envoy
\ No newline at end of file
+} // Envoy
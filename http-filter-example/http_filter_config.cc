@@ -8,13 +8,45 @@ namespace Envoy {
 namespace Server {
 namespace Configuration {
 
-class HttpSampleDecoderFilterConfig : public NamedHttpFilterConfigFactory {
+const std::string HTTP_SAMPLE_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "description": "JSON object to configure an instance of the sample http filter",
+    "additionalProperties": false,
+    "properties":{
+      "headers" : {
+        "type" : "array",
+        "description": "request header operations, applied in order. Defaults to adding via: sample-filter.",
+        "items" : {
+          "type" : "object",
+          "additionalProperties": false,
+          "properties" : {
+            "op" : {
+              "type" : "string",
+              "enum" : ["add", "set", "remove"],
+              "description": "add appends a value, set replaces any values, remove drops the header. Defaults to add."
+            },
+            "key" : {"type" : "string", "minLength" : 1},
+            "value" : {"type" : "string"}
+          },
+          "required" : ["key"]
+        }
+      }
+    }
+  }
+)EOF");
+
+class HttpSampleDecoderFilterConfigFactory : public NamedHttpFilterConfigFactory {
 public:
-  HttpFilterFactoryCb createFilterFactory(const Json::Object&, const std::string&,
+  HttpFilterFactoryCb createFilterFactory(const Json::Object& json_config, const std::string&,
                                           FactoryContext&) override {
-    return [](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+    json_config.validateSchema(HTTP_SAMPLE_SCHEMA);
+    Http::HttpSampleDecoderFilterConfigConstSharedPtr config(
+        new Http::HttpSampleDecoderFilterConfig(json_config));
+    return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
       callbacks.addStreamDecoderFilter(
-          Http::StreamDecoderFilterSharedPtr{new Http::HttpSampleDecoderFilter()});
+          Http::StreamDecoderFilterSharedPtr{new Http::HttpSampleDecoderFilter(config)});
     };
   }
   std::string name() override { return "sample"; }
@@ -23,7 +55,7 @@ public:
 /**
  * Static registration for this sample filter. @see RegisterFactory.
  */
-static Registry::RegisterFactory<HttpSampleDecoderFilterConfig, NamedHttpFilterConfigFactory>
+static Registry::RegisterFactory<HttpSampleDecoderFilterConfigFactory, NamedHttpFilterConfigFactory>
     register_;
 
 } // Configuration
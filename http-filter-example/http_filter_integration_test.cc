@@ -12,7 +12,7 @@ public:
   void SetUp() override {
     fake_upstreams_.emplace_back(new FakeUpstream(0, FakeHttpConnection::Type::HTTP1, version_));
     registerPort("upstream_0", fake_upstreams_.back()->localAddress()->ip()->port());
-    createTestServer("http-filter-example/envoy.conf", {"http"});
+    createTestServer("http-filter-example/envoy.conf", {"http", "http_headers"});
   }
 
   /**
@@ -47,4 +47,33 @@ TEST_P(HttpFilterSampleIntegrationTest, Test1) {
 
   codec_client->close();
 }
+
+TEST_P(HttpFilterSampleIntegrationTest, ConfiguredHeaders) {
+  Http::TestHeaderMapImpl headers{{":method", "GET"},         {":path", "/"},
+                                  {":authority", "host"},     {"x-sample-set", "old"},
+                                  {"x-sample-set", "older"},  {"x-sample-remove", "gone"}};
+
+  IntegrationStreamDecoderPtr response(new IntegrationStreamDecoder(*dispatcher_));
+  IntegrationCodecClientPtr codec_client =
+      makeHttpConnection(lookupPort("http_headers"), Http::CodecClient::Type::HTTP1);
+  codec_client->makeHeaderOnlyRequest(headers, *response);
+  FakeHttpConnectionPtr fake_upstream_connection = fake_upstreams_[0]->waitForHttpConnection(*dispatcher_);
+  FakeStreamPtr request_stream = fake_upstream_connection->waitForNewStream();
+  request_stream->waitForEndStream(*dispatcher_);
+  response->waitForEndStream();
+
+  Http::TestHeaderMapImpl upstream_headers(request_stream->headers());
+  EXPECT_EQ("sample-filter", upstream_headers.get_("via"));
+  EXPECT_EQ("new", upstream_headers.get_("x-sample-set"));
+  EXPECT_FALSE(upstream_headers.has("x-sample-remove"));
+  std::vector<std::string> added;
+  upstream_headers.iterate([](const Http::HeaderEntry& header, void* context) -> void {
+    if (std::string("x-sample-add") == header.key().c_str()) {
+      static_cast<std::vector<std::string>*>(context)->push_back(header.value().c_str());
+    }
+  }, &added);
+  EXPECT_EQ((std::vector<std::string>{"one", "two"}), added);
+
+  codec_client->close();
+}
 } // Envoy
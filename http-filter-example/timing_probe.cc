@@ -0,0 +1,106 @@
+#include "timing_probe.h"
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace Envoy {
+namespace Http {
+
+namespace {
+
+const char* const PHASE_NAMES[TimingProbeMarks::PHASES] = {
+    "decode_headers_us", "decode_data_us", "decode_trailers_us",
+    "encode_headers_us", "encode_data_us", "encode_trailers_us"};
+
+// the marks of the probes on this worker's live streams, by stream id
+// and probe name
+std::unordered_map<std::string, TimingProbeMarksSharedPtr>& workerProbes() {
+  static thread_local std::unordered_map<std::string, TimingProbeMarksSharedPtr> probes;
+  return probes;
+}
+
+std::string probeKey(uint64_t stream_id, const std::string& name) {
+  return std::to_string(stream_id) + "/" + name;
+}
+
+} // namespace
+
+TimingProbeConfig::TimingProbeConfig(const std::string& name, const std::string& since,
+                                     Stats::Scope& scope, const std::string& stats_prefix)
+    : name_(name), since_(since), scope_(scope) {
+  for (size_t i = 0; i < TimingProbeMarks::PHASES; i++) {
+    histograms_[i] = stats_prefix + "timing_probe." + name + "." + PHASE_NAMES[i];
+  }
+}
+
+TimingProbeFilter::TimingProbeFilter(TimingProbeConfigConstSharedPtr config)
+    : config_(config), marks_(new TimingProbeMarks()) {}
+
+TimingProbeFilter::~TimingProbeFilter() {}
+
+void TimingProbeFilter::setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) {
+  // filters are created in chain order, so an earlier probe is already
+  // in the table
+  if (!config_->since().empty()) {
+    auto since = workerProbes().find(probeKey(callbacks.streamId(), config_->since()));
+    if (since != workerProbes().end()) {
+      since_marks_ = since->second;
+    }
+  }
+  key_ = probeKey(callbacks.streamId(), config_->name());
+  workerProbes()[key_] = marks_;
+}
+
+void TimingProbeFilter::onDestroy() {
+  workerProbes().erase(key_);
+  if (!since_marks_) {
+    return;
+  }
+  // all phases are over by now, including the since probe's encoding
+  for (size_t i = 0; i < TimingProbeMarks::PHASES; i++) {
+    TimingProbePhase phase = static_cast<TimingProbePhase>(i);
+    MonotonicTime first = since_marks_->at(phase);
+    MonotonicTime last = marks_->at(phase);
+    if (phase >= TimingProbePhase::EncodeHeaders) {
+      std::swap(first, last);
+    }
+    if (first == MonotonicTime() || last == MonotonicTime() || last < first) {
+      continue;
+    }
+    config_->recordPhase(phase, std::chrono::duration_cast<std::chrono::microseconds>(last - first));
+  }
+}
+
+FilterHeadersStatus TimingProbeFilter::decodeHeaders(HeaderMap&, bool) {
+  marks_->mark(TimingProbePhase::DecodeHeaders);
+  return FilterHeadersStatus::Continue;
+}
+
+FilterDataStatus TimingProbeFilter::decodeData(Buffer::Instance&, bool) {
+  marks_->mark(TimingProbePhase::DecodeData);
+  return FilterDataStatus::Continue;
+}
+
+FilterTrailersStatus TimingProbeFilter::decodeTrailers(HeaderMap&) {
+  marks_->mark(TimingProbePhase::DecodeTrailers);
+  return FilterTrailersStatus::Continue;
+}
+
+FilterHeadersStatus TimingProbeFilter::encodeHeaders(HeaderMap&, bool) {
+  marks_->mark(TimingProbePhase::EncodeHeaders);
+  return FilterHeadersStatus::Continue;
+}
+
+FilterDataStatus TimingProbeFilter::encodeData(Buffer::Instance&, bool) {
+  marks_->mark(TimingProbePhase::EncodeData);
+  return FilterDataStatus::Continue;
+}
+
+FilterTrailersStatus TimingProbeFilter::encodeTrailers(HeaderMap&) {
+  marks_->mark(TimingProbePhase::EncodeTrailers);
+  return FilterTrailersStatus::Continue;
+}
+
+} // Http
+} // Envoy
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "envoy/common/time.h"
+#include "envoy/stats/stats.h"
+
+#include "server/config/network/http_connection_manager.h"
+
+namespace Envoy {
+namespace Http {
+
+/**
+ * The filter callbacks a probe timestamps.
+ */
+enum class TimingProbePhase {
+  DecodeHeaders,
+  DecodeData,
+  DecodeTrailers,
+  EncodeHeaders,
+  EncodeData,
+  EncodeTrailers
+};
+
+/**
+ * When one probe's stream last reached each phase; zero if it has not.
+ */
+struct TimingProbeMarks {
+  static const size_t PHASES = 6;
+
+  void mark(TimingProbePhase phase) { at_[static_cast<size_t>(phase)] = std::chrono::steady_clock::now(); }
+  MonotonicTime at(TimingProbePhase phase) const { return at_[static_cast<size_t>(phase)]; }
+
+  std::array<MonotonicTime, PHASES> at_{};
+};
+
+typedef std::shared_ptr<TimingProbeMarks> TimingProbeMarksSharedPtr;
+
+/**
+ * Configuration for one timing probe position in a filter chain.
+ */
+class TimingProbeConfig {
+public:
+  // since is the name of an earlier probe in the same chain, or empty for
+  // a probe that only marks
+  TimingProbeConfig(const std::string& name, const std::string& since, Stats::Scope& scope,
+                    const std::string& stats_prefix);
+
+  const std::string& name() const { return name_; }
+  const std::string& since() const { return since_; }
+
+  // the wall clock time spent by the filters between the since probe and
+  // this one in a phase, delivered straight to the stats sinks
+  void recordPhase(TimingProbePhase phase, std::chrono::microseconds time) const {
+    scope_.deliverHistogramToSinks(histograms_[static_cast<size_t>(phase)], time.count());
+  }
+
+private:
+  const std::string name_;
+  const std::string since_;
+  Stats::Scope& scope_;
+  std::array<std::string, TimingProbeMarks::PHASES> histograms_;
+};
+
+typedef std::shared_ptr<const TimingProbeConfig> TimingProbeConfigConstSharedPtr;
+
+/**
+ * A pass-through filter marking when a stream reaches it in each phase.
+ * A probe configured with since another probe placed before it in the
+ * same chain reports the time between them: decode phases run from the
+ * since probe to this one, encode phases from this one back to it. So two
+ * probes around a filter time that filter, including any time it holds
+ * the stream waiting on something, without changing it.
+ *
+ * Probes find each other through a per-worker table keyed by stream id;
+ * all filters of a stream run on one worker.
+ */
+class TimingProbeFilter : public StreamFilter {
+public:
+  TimingProbeFilter(TimingProbeConfigConstSharedPtr config);
+  ~TimingProbeFilter();
+
+  // Http::StreamFilterBase
+  void onDestroy() override;
+
+  // Http::StreamDecoderFilter
+  FilterHeadersStatus decodeHeaders(HeaderMap&, bool) override;
+  FilterDataStatus decodeData(Buffer::Instance&, bool) override;
+  FilterTrailersStatus decodeTrailers(HeaderMap&) override;
+  void setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callbacks) override;
+
+  // Http::StreamEncoderFilter
+  FilterHeadersStatus encodeHeaders(HeaderMap&, bool) override;
+  FilterDataStatus encodeData(Buffer::Instance&, bool) override;
+  FilterTrailersStatus encodeTrailers(HeaderMap&) override;
+  void setEncoderFilterCallbacks(StreamEncoderFilterCallbacks&) override {}
+
+private:
+  const TimingProbeConfigConstSharedPtr config_;
+  const TimingProbeMarksSharedPtr marks_;
+  // the since probe's marks, held past its onDestroy()
+  TimingProbeMarksSharedPtr since_marks_;
+  std::string key_;
+};
+
+} // Http
+} // Envoy
@@ -0,0 +1,57 @@
+#include <string>
+
+#include "timing_probe.h"
+
+#include "envoy/registry/registry.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+const std::string TIMING_PROBE_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "description": "JSON object to configure an instance of the timing_probe http filter",
+    "additionalProperties": false,
+    "properties":{
+      "name" : {
+        "type" : "string",
+        "minLength" : 1,
+        "description": "this probe's name, unique in the filter chain and naming its histograms"
+      },
+      "since" : {
+        "type" : "string",
+        "minLength" : 1,
+        "description": "an earlier probe in the chain; the time between the two is reported per phase"
+      }
+    },
+    "required" : ["name"]
+  }
+)EOF");
+
+/**
+ * Config registration for the timing_probe filter. @see NamedHttpFilterConfigFactory.
+ */
+class TimingProbeConfigFactory : public NamedHttpFilterConfigFactory {
+public:
+  HttpFilterFactoryCb createFilterFactory(const Json::Object& json_config, const std::string& stats_prefix,
+                                          FactoryContext& context) override {
+    json_config.validateSchema(TIMING_PROBE_SCHEMA);
+    Http::TimingProbeConfigConstSharedPtr config(new Http::TimingProbeConfig(
+        json_config.getString("name"), json_config.getString("since", ""), context.scope(), stats_prefix));
+    return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+      callbacks.addStreamFilter(Http::StreamFilterSharedPtr{new Http::TimingProbeFilter(config)});
+    };
+  }
+  std::string name() override { return "timing_probe"; }
+};
+
+/**
+ * Static registration for the timing_probe filter. @see RegisterFactory.
+ */
+static Registry::RegisterFactory<TimingProbeConfigFactory, NamedHttpFilterConfigFactory> register_;
+
+} // Configuration
+} // Server
+} // Envoy
@@ -0,0 +1,77 @@
+#include <memory>
+#include <string>
+
+#include "timing_probe.h"
+
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/stats/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+
+using testing::NiceMock;
+using testing::Return;
+using testing::_;
+
+namespace Http {
+
+class TimingProbeTest : public testing::Test {
+public:
+  TimingProbeTest() {
+    ON_CALL(callbacks_, streamId()).WillByDefault(Return(1));
+    ON_CALL(other_callbacks_, streamId()).WillByDefault(Return(2));
+  }
+
+  std::unique_ptr<TimingProbeFilter> probe(const std::string& name, const std::string& since,
+                                           StreamDecoderFilterCallbacks& callbacks) {
+    std::unique_ptr<TimingProbeFilter> filter(new TimingProbeFilter(
+        TimingProbeConfigConstSharedPtr{new TimingProbeConfig(name, since, stats_store_, "http.test.")}));
+    filter->setDecoderFilterCallbacks(callbacks);
+    return filter;
+  }
+
+  NiceMock<Stats::MockIsolatedStatsStore> stats_store_;
+  NiceMock<MockStreamDecoderFilterCallbacks> callbacks_;
+  NiceMock<MockStreamDecoderFilterCallbacks> other_callbacks_;
+  TestHeaderMapImpl headers_;
+};
+
+TEST_F(TimingProbeTest, BracketsFilter) {
+  std::unique_ptr<TimingProbeFilter> before = probe("before", "", callbacks_);
+  std::unique_ptr<TimingProbeFilter> after = probe("after", "before", callbacks_);
+
+  EXPECT_CALL(stats_store_, deliverHistogramToSinks(_, _)).Times(0);
+  EXPECT_CALL(stats_store_, deliverHistogramToSinks("http.test.timing_probe.after.decode_headers_us", _));
+  EXPECT_CALL(stats_store_, deliverHistogramToSinks("http.test.timing_probe.after.encode_headers_us", _));
+
+  // decode runs down the chain, encode back up it
+  EXPECT_EQ(FilterHeadersStatus::Continue, before->decodeHeaders(headers_, true));
+  EXPECT_EQ(FilterHeadersStatus::Continue, after->decodeHeaders(headers_, true));
+  EXPECT_EQ(FilterHeadersStatus::Continue, after->encodeHeaders(headers_, true));
+  EXPECT_EQ(FilterHeadersStatus::Continue, before->encodeHeaders(headers_, true));
+
+  // the later probe reports even after the earlier one has gone
+  before->onDestroy();
+  after->onDestroy();
+}
+
+TEST_F(TimingProbeTest, OtherStreamsAreNotBracketed) {
+  std::unique_ptr<TimingProbeFilter> before = probe("before", "", callbacks_);
+  std::unique_ptr<TimingProbeFilter> after = probe("after", "before", other_callbacks_);
+  std::unique_ptr<TimingProbeFilter> unknown = probe("unknown", "missing", callbacks_);
+
+  EXPECT_CALL(stats_store_, deliverHistogramToSinks(_, _)).Times(0);
+  before->decodeHeaders(headers_, true);
+  after->decodeHeaders(headers_, true);
+  unknown->decodeHeaders(headers_, true);
+
+  before->onDestroy();
+  after->onDestroy();
+  unknown->onDestroy();
+}
+
+} // Http
+} // Envoy
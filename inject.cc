@@ -1,29 +1,384 @@
 #include "inject.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <string>
 #include <vector>
-#include <chrono>
+
+#include "envoy/event/deferred_deletable.h"
+#include "envoy/network/connection.h"
 
 #include "common/grpc/common.h"
 #include "common/http/header_map_impl.h"
+#include "common/http/utility.h"
 #include "common/buffer/buffer_impl.h"
+#include "common/common/utility.h"
+#include "common/tracing/http_tracer_impl.h"
 
 #define PINT(a) reinterpret_cast<unsigned long long>(a)
 
 namespace Envoy {
 namespace Http {
 
+namespace {
+
+// Pool callbacks for speculative connects. The pending stream is
+// cancelled as soon as it is queued so nothing should be delivered. A
+// ready connection handed over anyway is left alone: resetting the
+// stream would close an http/1.1 connection the router could reuse, and
+// an unused encoder costs http/2 only a stream id.
+class SpeculativeConnectCallbacks : public ConnectionPool::Callbacks,
+                                    public StreamDecoder,
+                                    Logger::Loggable<Logger::Id::filter> {
+public:
+  // ConnectionPool::Callbacks
+  void onPoolFailure(ConnectionPool::PoolFailureReason, Upstream::HostDescriptionConstSharedPtr) override {}
+  void onPoolReady(StreamEncoder&, Upstream::HostDescriptionConstSharedPtr) override {
+    ENVOY_LOG(debug, "inject speculative connect found a ready connection");
+  }
+
+  // Http::StreamDecoder
+  void decodeHeaders(HeaderMapPtr&&, bool) override {}
+  void decodeData(Buffer::Instance&, bool) override {}
+  void decodeTrailers(HeaderMapPtr&&) override {}
+};
+
+SpeculativeConnectCallbacks speculative_connect_callbacks;
+
+// Erases a downstream connection's memo entries when it closes, then
+// deletes itself. The worker state is held weakly so a connection that
+// outlives it costs nothing.
+class InjectMemoConnectionCallbacks : public Network::ConnectionCallbacks, public Event::DeferredDeletable {
+public:
+  InjectMemoConnectionCallbacks(std::weak_ptr<InjectWorkerState> worker_state, uint64_t connection_id,
+                                Event::Dispatcher& dispatcher)
+      : worker_state_(worker_state), connection_id_(connection_id), dispatcher_(dispatcher) {}
+
+  // Network::ConnectionCallbacks
+  void onEvent(Network::ConnectionEvent event) override {
+    if (event != Network::ConnectionEvent::RemoteClose && event != Network::ConnectionEvent::LocalClose) {
+      return;
+    }
+    InjectWorkerStateSharedPtr worker_state = worker_state_.lock();
+    if (worker_state) {
+      worker_state->memo_.eraseConnection(connection_id_);
+    }
+    dispatcher_.deferredDelete(Event::DeferredDeletablePtr{this});
+  }
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
+
+private:
+  const std::weak_ptr<InjectWorkerState> worker_state_;
+  const uint64_t connection_id_;
+  Event::Dispatcher& dispatcher_;
+};
+
+// all inject span tags are set before the span is finished
+class InjectSpanFinalizer : public Tracing::SpanFinalizer {
+public:
+  void finalize(Tracing::Span&) override {}
+};
+
+InjectSpanFinalizer inject_span_finalizer;
+
+const std::string inject_span_name{"InjectHeaders"};
+const std::string inject_result_tag{"inject.result"};
+const std::string inject_action_tag{"inject.action"};
+const std::string inject_timeout_tag{"inject.timeout_ms"};
+const std::string inject_grpc_status_tag{"inject.grpc_status"};
+const std::string inject_cancelled_tag{"inject.cancelled"};
+const std::string inject_cache_tag{"inject.cache"};
+
+// value of the first header with the given name in an inject response
+// header list, or nullptr if there is none
+const std::string* findInjectHeader(const google::protobuf::RepeatedPtrField<inject::Header>& headers,
+                                    const std::string& key) {
+  for (const inject::Header& h : headers) {
+    if (h.key() == key) {
+      return &h.value();
+    }
+  }
+  return nullptr;
+}
+
+bool containsName(const google::protobuf::RepeatedPtrField<std::string>& names, const std::string& name) {
+  for (const std::string& element : names) {
+    if (element == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// the route's opaque_config value for the first of keys it has
+const std::string* findOpaqueConfig(const Router::RouteEntry& route, const std::vector<std::string>& keys) {
+  const std::multimap<std::string, std::string>& opaque_config = route.opaqueConfig();
+  for (const std::string& key : keys) {
+    auto value = opaque_config.find(key);
+    if (value != opaque_config.end()) {
+      return &value->second;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+static const Http::LowerCaseString cookie_hdr_name{"cookie"};
+
+uint64_t InjectFilterConfig::nextGeneration() {
+  static std::atomic<uint64_t> next_generation{};
+  return ++next_generation;
+}
+
+void InjectFilterConfig::setRouteConfigs(const std::string& filter_stat_prefix,
+                                         std::map<std::string, std::shared_ptr<InjectFilterConfig>>&& route_configs) {
+  if (!filter_stat_prefix.empty()) {
+    route_disabled_keys_.insert(route_disabled_keys_.begin(), "inject." + filter_stat_prefix + ".disabled");
+    route_config_keys_.insert(route_config_keys_.begin(), "inject." + filter_stat_prefix + ".config");
+  }
+  route_configs_ = std::move(route_configs);
+}
+
+bool InjectFilterConfig::routeDisabled(const Router::RouteEntry& route) const {
+  const std::string* disabled = findOpaqueConfig(route, route_disabled_keys_);
+  return disabled != nullptr && *disabled == "true";
+}
+
+const std::shared_ptr<InjectFilterConfig>* InjectFilterConfig::routeConfig(const Router::RouteEntry& route) const {
+  const std::string* name = findOpaqueConfig(route, route_config_keys_);
+  if (name == nullptr) {
+    return nullptr;
+  }
+  auto config = route_configs_.find(*name);
+  return config == route_configs_.end() ? nullptr : &config->second;
+}
+
+void InjectLatencyHistogram::record(std::chrono::microseconds latency) {
+  uint64_t us = latency.count() > 0 ? latency.count() : 0;
+  size_t bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+  buckets_[std::min(bucket, BUCKETS - 1)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void InjectLatencyHistogram::addTo(Counts& counts) const {
+  for (size_t i = 0; i < BUCKETS; i++) {
+    counts[i] += buckets_[i].load(std::memory_order_relaxed);
+  }
+}
+
+uint64_t InjectLatencyHistogram::quantile(const Counts& counts, double q) {
+  uint64_t total = 0;
+  for (uint64_t count : counts) {
+    total += count;
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = std::max<uint64_t>(1, std::ceil(q * total));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return 1ULL << i;
+    }
+  }
+  return 1ULL << (BUCKETS - 1);
+}
+
+bool InjectConcurrencyLimiter::admit(uint64_t active, const InjectConcurrencyLimitConfig& config) {
+  uint32_t limit = limit_;
+  if (limit == 0) {
+    limit = config.initial_limit_;
+  }
+  // a reload may have moved the bounds
+  limit = std::min(config.max_limit_, std::max(config.min_limit_, limit));
+  limit_ = limit;
+  return active < limit;
+}
+
+void InjectConcurrencyLimiter::record(std::chrono::microseconds latency, MonotonicTime now,
+                                      const InjectConcurrencyLimitConfig& config) {
+  if (window_samples_ == 0) {
+    window_start_ = now;
+  }
+  window_samples_++;
+  window_latency_ += latency;
+  if (now - window_start_ >= config.sample_window_) {
+    update(config);
+  }
+}
+
+void InjectConcurrencyLimiter::update(const InjectConcurrencyLimitConfig& config) {
+  const std::chrono::microseconds sample =
+      std::max(std::chrono::microseconds(1), window_latency_ / window_samples_);
+  window_samples_ = 0;
+  window_latency_ = std::chrono::microseconds(0);
+
+  if (next_baseline_.count() == 0 || sample < next_baseline_) {
+    next_baseline_ = sample;
+  }
+  if (baseline_.count() == 0 || sample < baseline_) {
+    baseline_ = sample;
+  }
+  if (++baseline_age_ >= config.baseline_windows_) {
+    baseline_ = next_baseline_;
+    next_baseline_ = std::chrono::microseconds(0);
+    baseline_age_ = 0;
+  }
+
+  const double gradient =
+      std::min(1.0, std::max(0.5, config.tolerance_ * baseline_.count() / sample.count()));
+  const uint32_t current = limit_;
+  const double limit = current ? current : config.initial_limit_;
+  const double new_limit = gradient * limit + std::sqrt(limit);
+  limit_ = static_cast<uint32_t>(std::min<double>(config.max_limit_, std::max<double>(config.min_limit_, new_limit)));
+}
+
+InjectResponseConstSharedPtr InjectConnectionMemo::lookup(uint64_t connection_id, const std::string& key,
+                                                         MonotonicTime now) {
+  auto connection = connections_.find(connection_id);
+  if (connection == connections_.end()) {
+    return nullptr;
+  }
+  auto entry = connection->second.find(key);
+  if (entry == connection->second.end()) {
+    return nullptr;
+  }
+  if (entry->second.expiry_ <= now) {
+    erase(connection->second, entry);
+    return nullptr;
+  }
+  return entry->second.response_;
+}
+
+bool InjectConnectionMemo::insert(uint64_t connection_id, const std::string& key,
+                                  InjectResponseConstSharedPtr response, MonotonicTime now,
+                                  std::chrono::milliseconds ttl, uint64_t max_entries) {
+  auto connection = connections_.find(connection_id);
+  const bool new_connection = connection == connections_.end();
+  if (new_connection) {
+    connection = connections_.emplace(connection_id, ConnectionEntries{}).first;
+  }
+  ConnectionEntries& entries = connection->second;
+  auto existing = entries.find(key);
+  if (existing != entries.end()) {
+    erase(entries, existing);
+  }
+  while (!order_.empty()) {
+    ConnectionEntries& oldest_entries = connections_.at(order_.front().first);
+    auto oldest = oldest_entries.find(order_.front().second);
+    if (size_ < max_entries && oldest->second.expiry_ > now) {
+      break;
+    }
+    erase(oldest_entries, oldest);
+  }
+  order_.emplace_back(connection_id, key);
+  entries.emplace(key, Entry{response, now + ttl, std::prev(order_.end())});
+  size_++;
+  return new_connection;
+}
+
+void InjectConnectionMemo::eraseConnection(uint64_t connection_id) {
+  auto connection = connections_.find(connection_id);
+  if (connection == connections_.end()) {
+    return;
+  }
+  for (const auto& entry : connection->second) {
+    order_.erase(entry.second.order_);
+  }
+  size_ -= connection->second.size();
+  connections_.erase(connection);
+}
+
+void InjectConnectionMemo::erase(ConnectionEntries& entries, ConnectionEntries::iterator entry) {
+  order_.erase(entry->second.order_);
+  entries.erase(entry);
+  size_--;
+}
+
+InjectWorkerStateSharedPtr InjectWorkerStates::get(Event::Dispatcher& dispatcher) {
+  std::unique_lock<std::mutex> lock(lock_);
+  for (const auto& state : states_) {
+    if (state.first == &dispatcher) {
+      return state.second;
+    }
+  }
+  states_.emplace_back(&dispatcher, std::make_shared<InjectWorkerState>());
+  return states_.back().second;
+}
+
+std::vector<InjectWorkerStateSharedPtr> InjectWorkerStates::all() {
+  std::unique_lock<std::mutex> lock(lock_);
+  std::vector<InjectWorkerStateSharedPtr> states;
+  for (const auto& state : states_) {
+    states.push_back(state.second);
+  }
+  return states;
+}
+
+InjectFilterConfigProvider::InjectFilterConfigProvider(ThreadLocal::Instance& tls,
+                                                       InjectFilterConfigSharedPtr config)
+  : worker_states_(std::make_shared<InjectWorkerStates>()), tls_slot_(tls.allocateSlot()) {
+  update(config);
+}
+
+InjectFilterConfigSharedPtr InjectFilterConfigProvider::config() {
+  return tls_slot_->getTyped<ThreadLocalInjectConfig>().config_;
+}
+
+InjectWorkerStateSharedPtr InjectFilterConfigProvider::workerState() {
+  return tls_slot_->getTyped<ThreadLocalInjectConfig>().worker_state_;
+}
+
+void InjectFilterConfigProvider::update(InjectFilterConfigSharedPtr config) {
+  // each worker drops its reference to the old snapshot when the new
+  // one lands; filters still holding it keep it alive until they finish.
+  // Worker state carries over from the previous snapshot.
+  InjectWorkerStatesSharedPtr worker_states = worker_states_;
+  tls_slot_->set([config, worker_states](Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+      return std::make_shared<ThreadLocalInjectConfig>(config, worker_states->get(dispatcher));
+    });
+}
+
 // called for gRPC call to InjectHeader
-void InjectFilter::onCreateInitialMetadata(Http::HeaderMap& ) {
+void InjectFilter::onCreateInitialMetadata(Http::HeaderMap& metadata) {
+  // propagate the inject span's context so the injector's own spans
+  // join this trace
+  if (inject_span_) {
+    inject_span_->injectContext(metadata);
+  }
 }
 
 // called for gRPC call to InjectHeader
 void InjectFilter::onSuccess(std::unique_ptr<inject::InjectResponse>&& resp) {
   ENVOY_LOG(trace,"InjectFilter::onSuccess (wasSending={}), cb on filter: {}",state_ == State::SendingInjectRequest, PINT(this));
+  config_->stats().rpc_success_.inc();
+  config_->stats().rpc_bytes_received_.add(resp->ByteSize());
+  config_->resultCounter(resp->result()).inc();
 
   // put response & matching action in filter state then run appropriate handler
   inject_action_ = &config_->action_matcher().match(resp->result());
+  captureRpc(resp->result(), resp.get(), Grpc::Status::GrpcStatus::Ok);
+  if (inject_span_) {
+    inject_span_->setTag(inject_result_tag, resp->result());
+    inject_span_->setTag(inject_action_tag, inject_action_->action_ == "dynamic" ? resp->action()
+                                                                                : inject_action_->action_);
+  }
+  onRpcComplete();
   inject_response_ = std::move(resp);
+  if (!memo_key_.empty()) {
+    const Network::Connection& connection = *decoder_callbacks_->connection();
+    if (worker_state_->memo_.insert(connection.id(), memo_key_, inject_response_, std::chrono::steady_clock::now(),
+                                    config_->memo_ttl(), config_->memo_max_entries())) {
+      // the connection manager only hands filters a const connection;
+      // watching for its close does not change it
+      const_cast<Network::Connection&>(connection).addConnectionCallbacks(
+          *new InjectMemoConnectionCallbacks(worker_state_, connection.id(), decoder_callbacks_->dispatcher()));
+    }
+  }
   handleAction();
 }
 
@@ -31,71 +386,174 @@ void InjectFilter::onSuccess(std::unique_ptr<inject::InjectResponse>&& resp) {
 void InjectFilter::onFailure(Grpc::Status::GrpcStatus status, const std::string& message) {
   bool wasSending =   state_ == State::SendingInjectRequest;
   ENVOY_LOG(warn,"onFailure({}), wasSending={}, msg='{}' called on icb: {}", status, wasSending, message,  PINT(this));
+  if (status == Grpc::Status::GrpcStatus::DeadlineExceeded
+      || std::chrono::steady_clock::now() - rpc_start_ >= std::chrono::milliseconds(config_->timeout_ms())) {
+    config_->stats().rpc_timeout_.inc();
+    captureRpc("local.timeout", nullptr, status);
+  } else {
+    config_->stats().rpc_failure_.inc();
+    captureRpc("local.error", nullptr, status);
+  }
   inject_action_ = &config_->action_matcher().errorAction();
+  if (inject_span_) {
+    inject_span_->setTag(Tracing::Tags::get().ERROR, Tracing::Tags::get().TRUE);
+    inject_span_->setTag(inject_grpc_status_tag, std::to_string(status));
+    inject_span_->setTag(inject_action_tag, inject_action_->action_);
+  }
+  onRpcComplete();
   handleAction();
 }
 
 void InjectFilter::onDestroy() {
   if (state_ == State::InjectRequestSent) {
-    if (req_) {
-      req_->cancel();
-      req_ = nullptr;
-    }
+    cancelInjectRequest();
   }
+  onRpcComplete();
   state_ = State::Done;
   ENVOY_LOG(trace,"decoder filter onDestroy called on: {}", PINT(this));
 }
 
 
+// the inject RPC finished one way or another (response, error,
+// timeout or cancellation)
+void InjectFilter::onRpcComplete(bool sample) {
+  if (rpc_outstanding_) {
+    rpc_outstanding_ = false;
+    config_->stats().rpc_active_.dec();
+    if (worker_state_) {
+      const MonotonicTime now = std::chrono::steady_clock::now();
+      const std::chrono::microseconds latency = std::chrono::duration_cast<std::chrono::microseconds>(now - rpc_start_);
+      worker_state_->rpc_active_--;
+      worker_state_->rpc_latency_.record(latency);
+      if (sample && config_->concurrency_limit()) {
+        worker_state_->limiter_.record(latency, now, *config_->concurrency_limit());
+      }
+    }
+  }
+  if (rpc_latency_) {
+    rpc_latency_->complete();
+    rpc_latency_.reset();
+  }
+  if (inject_span_) {
+    inject_span_->finishSpan(inject_span_finalizer);
+    inject_span_.reset();
+  }
+}
+
+// give up on an outstanding inject RPC
+void InjectFilter::cancelInjectRequest() {
+  if (req_) {
+    req_->cancel();
+    req_ = nullptr;
+  }
+  if (inject_span_) {
+    inject_span_->setTag(inject_cancelled_tag, Tracing::Tags::get().TRUE);
+  }
+  captureRpc("local.cancelled", nullptr, Grpc::Status::GrpcStatus::Ok);
+  onRpcComplete(false);
+}
+
+// a triggered request going on without its inject RPC: as if it had not
+// triggered, or with the local.error action
+FilterHeadersStatus InjectFilter::skipInjectRequest(HeaderMap& headers, bool error_action) {
+  if (!error_action) {
+    added_latency_.reset();
+    return FilterHeadersStatus::Continue;
+  }
+  inject_action_ = &config_->action_matcher().errorAction();
+  upstream_headers_ = &headers;
+  state_ = State::SendingInjectRequest;
+  handleAction();
+  return state_ == State::WaitingForUpstream ? FilterHeadersStatus::Continue : FilterHeadersStatus::StopIteration;
+}
+
+// write the finished RPC to the capture file if it was sampled
+void InjectFilter::captureRpc(const std::string& result, const inject::InjectResponse* response,
+                              Grpc::Status::GrpcStatus status) {
+  if (!capture_request_) {
+    return;
+  }
+  inject::InjectCaptureRecord record;
+  record.set_start_time_us(capture_start_us_);
+  record.set_latency_us(
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - rpc_start_).count());
+  record.set_allocated_request(capture_request_.release());
+  if (response) {
+    *record.mutable_response() = *response;
+  }
+  record.set_result(result);
+  record.set_grpc_status(status);
+  if (config_->capture()->write(record)) {
+    config_->stats().capture_records_.inc();
+  } else {
+    config_->stats().capture_dropped_.inc();
+  }
+}
+
+// child span for the InjectHeaders RPC; must exist before send() as
+// the gRPC client asks for initial metadata while starting the stream
+void InjectFilter::startInjectSpan() {
+  inject_span_ = decoder_callbacks_->activeSpan().spawnChild(Tracing::EgressConfig::get(), inject_span_name,
+                                                             ProdSystemTimeSource::instance_.currentTime());
+  if (!inject_span_) {
+    return;
+  }
+  inject_span_->setTag(Tracing::Tags::get().UPSTREAM_CLUSTER, config_->cluster_name());
+  inject_span_->setTag(inject_timeout_tag, std::to_string(config_->timeout_ms()));
+}
+
 void InjectFilter::handleAction()  {
+  resumeReading();
   if (inject_action_->action_ == "passthrough"
-      || (inject_action_->action_ == "dynamic" && inject_response_->action() == "passthrough")) {
+      || (inject_action_->action_ == "dynamic" && inject_response_ != nullptr
+          && inject_response_->action() == "passthrough")) {
+    config_->stats().action_passthrough_.inc();
     handlePassThroughAction();
   } else {
+    config_->stats().action_abort_.inc();
     handleAbortAction();
   }
+  if (added_latency_) {
+    added_latency_->complete();
+    added_latency_.reset();
+  }
 }
 
 void InjectFilter::handlePassThroughAction()  {
   ENVOY_LOG(trace,"decoder filter handling passthrough (post inj response) {}", PINT(this));
   const InjectAction& action = *inject_action_;
-  if (action.upstream_inject_any_) {
+  // only consulted when the action asks for the route to be redone
+  bool reroute = false;
+  if (inject_response_ == nullptr) {
+    // error action passthrough - nothing to inject
+  } else if (action.upstream_inject_any_) {
     // inject every header returned in gRPC response #trust
-    for (int i = 0; i < inject_response_->upstreamheaders_size(); ++i) {
-      const inject::Header& h = inject_response_->upstreamheaders(i);
-      Http::LowerCaseString lckey(h.key().c_str());
-      upstream_headers_->addCopy(lckey, h.value());
-    }
-    for (int i = 0; i < inject_response_->upstreamremoveheadernames_size(); ++i) {
-      const std::string h = inject_response_->upstreamremoveheadernames(i);
-      Http::LowerCaseString lckey(h.c_str());
+    for (const inject::Header& h : inject_response_->upstreamheaders()) {
+      injected_keys_.emplace_back(h.key());
+      upstream_headers_->addReference(injected_keys_.back(), h.value());
+      reroute = reroute || (action.redo_routing_ && affectsRouting(injected_keys_.back()));
+    }
+    for (const std::string& h : inject_response_->upstreamremoveheadernames()) {
+      Http::LowerCaseString lckey(h);
       upstream_headers_->remove(lckey);
+      reroute = reroute || (action.redo_routing_ && affectsRouting(lckey));
     }
   } else {
     // just inject the ones allowed by filter config
-    std::map<std::string,std::string> inject_hdrs;
-    for (int i = 0; i < inject_response_->upstreamheaders_size(); ++i) {
-      const inject::Header& h = inject_response_->upstreamheaders(i);
-      inject_hdrs.insert(std::pair<std::string,std::string>(h.key(), h.value()));
-    }
-    std::map<std::string,std::string> remove_hdrs;
-    for (int i = 0; i < inject_response_->upstreamremoveheadernames_size(); ++i) {
-      const std::string h = inject_response_->upstreamremoveheadernames(i);
-      remove_hdrs.insert(std::pair<std::string,std::string>(h, h));
-    }
     for (const Http::LowerCaseString& element : action.upstream_inject_headers_) {
-      std::map<std::string,std::string>::iterator it = remove_hdrs.find(element.get());
-      if (it != remove_hdrs.end()) {
+      if (containsName(inject_response_->upstreamremoveheadernames(), element.get())) {
         ENVOY_LOG(info, "Removing upstream {}",element.get());
         upstream_headers_->remove(element);
+        reroute = reroute || (action.redo_routing_ && affectsRouting(element));
         continue;
       }
-      it = inject_hdrs.find(element.get());
-      if (it != inject_hdrs.end()) {
+      const std::string* value = findInjectHeader(inject_response_->upstreamheaders(), element.get());
+      if (value) {
         upstream_headers_->remove(element);
-        if (it->second != "") {
-          ENVOY_LOG(info, "Injecting upstream {}:{}",element.get(), it->second);
-          upstream_headers_->addReferenceKey(element, it->second);
+        reroute = reroute || (action.redo_routing_ && affectsRouting(element));
+        if (!value->empty()) {
+          ENVOY_LOG(info, "Injecting upstream {}:{}",element.get(), *value);
+          upstream_headers_->addReference(element, *value);
         }
       }
     }
@@ -104,12 +562,23 @@ void InjectFilter::handlePassThroughAction()  {
   // remove any headers named in the config
   for (const Http::LowerCaseString& element : action.upstream_remove_headers_) {
     upstream_headers_->remove(element);
+    reroute = reroute || (action.redo_routing_ && affectsRouting(element));
   }
 
   // remove any cookies as defined in config
   for (const std::string& name: action.upstream_remove_cookie_names_) {
     removeNamedCookie(name, *upstream_headers_);
   }
+  if (!action.upstream_remove_cookie_names_.empty()) {
+    reroute = reroute || (action.redo_routing_ && affectsRouting(cookie_hdr_name));
+  }
+
+  if (reroute) {
+    // the route cached for this stream may depend on a header we just
+    // changed; the router will look it up again when decoding resumes.
+    ENVOY_LOG(debug, "inject redoing routing after header injection {}", PINT(this));
+    decoder_callbacks_->clearRouteCache();
+  }
 
   bool wasSending =   state_ == State::SendingInjectRequest;
   state_ = State::WaitingForUpstream;
@@ -170,6 +639,32 @@ void InjectFilter::handleAbortAction()  {
 }
 
 
+// the connection memo key for this request within its connection: the
+// config's generation and the trigger header and cookie values present.
+// The memo is shared by every config on the worker, and a response
+// fetched for one (another cluster, other actions) must not stand in for
+// another's RPC. False if the memo is off or there is no connection.
+bool InjectFilter::memoKey(const HeaderMap& headers, std::string& key) {
+  if (config_->memo_ttl().count() == 0 || !worker_state_ || !decoder_callbacks_->connection()) {
+    return false;
+  }
+  key = std::to_string(config_->generation());
+  for (const InjectHeaderData& hd : config_->trigger_headers()) {
+    const Http::HeaderEntry* h = headers.get(hd.name_);
+    if (h != nullptr && matchHeader(*h, hd)) {
+      key.append(1, '\0').append(h->key().c_str()).append(1, '=').append(h->value().c_str());
+    }
+  }
+  const char* cookie_value;
+  size_t cookie_length;
+  for (const std::string& name : config_->trigger_cookie_names()) {
+    if (findCookieValue(headers, name, cookie_value, cookie_length) && cookie_length > 0) {
+      key.append(1, '\0').append("cookie.").append(name).append(1, '=').append(cookie_value, cookie_length);
+    }
+  }
+  return true;
+}
+
 // decodeHeaders - see if any configured headers are present, and if so send them to
 // the configured header injection service
 FilterHeadersStatus InjectFilter::decodeHeaders(HeaderMap& headers, bool end_stream) {
@@ -180,6 +675,23 @@ FilterHeadersStatus InjectFilter::decodeHeaders(HeaderMap& headers, bool end_str
     return FilterHeadersStatus::Continue;
   }
 
+  // the route may turn this filter off or swap in one of its route
+  // configs; most routes set nothing, which costs one empty() check
+  Router::RouteConstSharedPtr route = decoder_callbacks_->route();
+  if (route && route->routeEntry() && !route->routeEntry()->opaqueConfig().empty()) {
+    const Router::RouteEntry& route_entry = *route->routeEntry();
+    if (config_->routeDisabled(route_entry)) {
+      ENVOY_LOG(trace,"leaving InjectFilter::decodeHeaders, disabled by route, filter inst: {}", PINT(this));
+      config_->stats().route_disabled_.inc();
+      return FilterHeadersStatus::Continue;
+    }
+    const InjectFilterConfigSharedPtr* route_config = config_->routeConfig(route_entry);
+    if (route_config) {
+      config_->stats().route_config_.inc();
+      config_ = *route_config;
+    }
+  }
+
   bool triggered = config_->always_triggered();
 
   // don't attempt to inject anything if any anti-trigger header is in
@@ -187,50 +699,81 @@ FilterHeadersStatus InjectFilter::decodeHeaders(HeaderMap& headers, bool end_str
   if (!triggered ) {
     if (matchAnyHeaders(headers, config_->antitrigger_headers())) {
       ENVOY_LOG(trace,"leaving InjectFilter::decodeHeaders, antitrigger headers match, inst: {}", PINT(this));
+      config_->stats().antitriggered_.inc();
       return FilterHeadersStatus::Continue;
     }
   }
 
-  inject::InjectRequest ir; // sizeof is 72
-  for (const Router::ConfigUtility::HeaderData& hd : config_->trigger_headers()) {
-    const Http::HeaderEntry* h = headers.get(hd.name_);
-    if (h == nullptr) {
-      continue;
-    }
-    if (matchHeader(*h, hd)) {
-      triggered = true;
-      if (config_->include_all_headers()) {
+  // Decide whether we trigger before building anything: most requests
+  // don't, and that path must not allocate. The trigger headers and
+  // cookies are looked up again below to build the inject request.
+  const char* cookie_value{};
+  size_t cookie_length{};
+  if (!triggered) {
+    for (const InjectHeaderData& hd : config_->trigger_headers()) {
+      const Http::HeaderEntry* h = headers.get(hd.name_);
+      if (h != nullptr && matchHeader(*h, hd)) {
+        triggered = true;
         break;
       }
-      inject::Header* ih = ir.mutable_inputheaders()->Add();
-      ih->set_key(h->key().c_str());
-      ih->set_value(h->value().c_str());
     }
   }
-
-  // check for cookies with names that trigger injection and add them.
-  if (!triggered || !config_->include_all_headers()) {
+  if (!triggered) {
     for (const std::string& name: config_->trigger_cookie_names()) {
-      std::string cookie_value = Http::Utility::parseCookieValue(headers, name);
-      if (cookie_value.empty()) {
-        continue;
-      }
-      triggered = true;
-      if (config_->include_all_headers()) {
+      if (findCookieValue(headers, name, cookie_value, cookie_length) && cookie_length > 0) {
+        triggered = true;
         break;
       }
-      inject::Header* ih = ir.mutable_inputheaders()->Add();
-      ih->mutable_key()->append("cookie.").append(name);
-      ih->set_value(cookie_value.c_str());
     }
   }
 
   if (!triggered) {
     ENVOY_LOG(trace,"leaving InjectFilter::decodeHeaders, no triggered filter inst: {}", PINT(this));
+    config_->stats().not_triggered_.inc();
     return FilterHeadersStatus::Continue;
   }
+  config_->stats().triggered_.inc();
+  added_latency_ = config_->stats().added_latency_.allocateSpan();
   ENVOY_LOG(info, "Inject trigger matched: {}", PINT(this));
 
+  // a response remembered for these trigger values on this connection
+  // stands in for the RPC
+  std::string memo_key;
+  if (memoKey(headers, memo_key)) {
+    inject_response_ = worker_state_->memo_.lookup(decoder_callbacks_->connection()->id(), memo_key,
+                                                   std::chrono::steady_clock::now());
+    if (inject_response_) {
+      config_->stats().memo_hit_.inc();
+      decoder_callbacks_->activeSpan().setTag(inject_cache_tag, "hit");
+      inject_action_ = &config_->action_matcher().match(inject_response_->result());
+      upstream_headers_ = &headers;
+      // no continueDecoding() from the passthrough handler
+      state_ = State::SendingInjectRequest;
+      handleAction();
+      return state_ == State::WaitingForUpstream ? FilterHeadersStatus::Continue : FilterHeadersStatus::StopIteration;
+    }
+    config_->stats().memo_miss_.inc();
+    memo_key_ = std::move(memo_key);
+  }
+
+  // runtime says the injector needs relief
+  if (config_->shed()) {
+    ENVOY_LOG(debug, "Inject RPC shed: {}", PINT(this));
+    config_->stats().shed_.inc();
+    return skipInjectRequest(headers, config_->shed_action() == InjectFilterConfig::ShedAction::Error);
+  }
+
+  // or this worker already has as many RPCs out as the injector can take
+  const InjectConcurrencyLimitConfig* limit = config_->concurrency_limit();
+  if (limit && worker_state_ && !worker_state_->limiter_.admit(worker_state_->rpc_active_, *limit)) {
+    ENVOY_LOG(debug, "Inject RPC over the concurrency limit of {}: {}", worker_state_->limiter_.limit(), PINT(this));
+    config_->stats().rpc_over_limit_.inc();
+    return skipInjectRequest(headers,
+                             limit->over_limit_action_ == InjectConcurrencyLimitConfig::OverLimitAction::Error);
+  }
+
+  inject::InjectRequest ir; // sizeof is 72
+
   // add additional headers of interest to inject request
   if (config_->include_all_headers()) {
     headers.iterate([](const HeaderEntry& h, void* irp) -> void {
@@ -240,6 +783,23 @@ FilterHeadersStatus InjectFilter::decodeHeaders(HeaderMap& headers, bool end_str
         ih->set_value(h.value().c_str());
       }, static_cast<void*>(&ir));
   } else {
+    // the trigger headers and cookies present
+    for (const InjectHeaderData& hd : config_->trigger_headers()) {
+      const Http::HeaderEntry* h = headers.get(hd.name_);
+      if (h != nullptr && matchHeader(*h, hd)) {
+        inject::Header* ih = ir.mutable_inputheaders()->Add();
+        ih->set_key(h->key().c_str());
+        ih->set_value(h->value().c_str());
+      }
+    }
+    for (const std::string& name: config_->trigger_cookie_names()) {
+      if (findCookieValue(headers, name, cookie_value, cookie_length) && cookie_length > 0) {
+        inject::Header* ih = ir.mutable_inputheaders()->Add();
+        ih->mutable_key()->append("cookie.").append(name);
+        ih->set_value(cookie_value, cookie_length);
+      }
+    }
+
     // just include extras asked for
     for (const Http::LowerCaseString& element : config_->include_headers()) {
       const Http::HeaderEntry* h = headers.get(element);
@@ -259,16 +819,46 @@ FilterHeadersStatus InjectFilter::decodeHeaders(HeaderMap& headers, bool end_str
   }
 
   client_ = config_->inject_client();
+  // stash headers for mutation based on response (which may arrive
+  // before send() returns)
+  upstream_headers_ = &headers;
 
   // SendingInjectRequest state signals our onSuccess() impl to not
   // continuing decode if we get an inject response after passing
   // control to event loop via send() call below and onSuccess() is
   // called before it returns.
   state_ = State::SendingInjectRequest;
-  req_ = client_->send(config_->method_descriptor(), ir, *this, std::chrono::milliseconds(config_->timeout_ms()));
+  rpc_outstanding_ = true;
+  config_->stats().rpc_active_.inc();
+  if (worker_state_) {
+    worker_state_->rpc_active_++;
+  }
+  config_->stats().rpc_bytes_sent_.add(ir.ByteSize());
+  rpc_start_ = std::chrono::steady_clock::now();
+  rpc_latency_ = config_->stats().rpc_latency_.allocateSpan();
+  startInjectSpan();
+  if (inject_span_ && !memo_key_.empty()) {
+    inject_span_->setTag(inject_cache_tag, "miss");
+  }
+  const inject::InjectRequest* request = &ir;
+  if (config_->capture() && config_->capture()->sample()) {
+    // the request is kept for the capture record rather than copied
+    capture_request_.reset(new inject::InjectRequest());
+    capture_request_->Swap(&ir);
+    request = capture_request_.get();
+    capture_start_us_ = std::chrono::duration_cast<std::chrono::microseconds>(
+        ProdSystemTimeSource::instance_.currentTime().time_since_epoch()).count();
+  }
+  req_ = client_->send(config_->method_descriptor(), *request, *this, std::chrono::milliseconds(config_->timeout_ms()));
 
   if (!req_) {
     ENVOY_LOG(warn, "Could not send inject gRPC request. Null req returned by send(). Using error action. {}", PINT(this));
+    if (rpc_outstanding_) {
+      // not already reported through onFailure()
+      config_->stats().rpc_failure_.inc();
+      captureRpc("local.error", nullptr, Grpc::Status::GrpcStatus::Unavailable);
+      onRpcComplete();
+    }
     inject_action_ = &config_->action_matcher().errorAction();
     handleAction();
     if (state_ == State::WaitingForUpstream) {
@@ -283,6 +873,9 @@ FilterHeadersStatus InjectFilter::decodeHeaders(HeaderMap& headers, bool end_str
 
   if (state_ == State::SendingInjectRequest) {
     state_ = State::InjectRequestSent;
+    if (config_->speculative_connect()) {
+      speculativeConnect();
+    }
   }
 
   if (state_ == State::WaitingForUpstream) {
@@ -291,18 +884,116 @@ FilterHeadersStatus InjectFilter::decodeHeaders(HeaderMap& headers, bool end_str
   }
 
   // give control back to event loop so gRPC inject response or timeout
-  // can initiate next steps. Stash headers for mutation based on response.
-  upstream_headers_ = &headers;
+  // can initiate next steps.
   return FilterHeadersStatus::StopIteration;
 }
 
-FilterDataStatus InjectFilter::decodeData(Buffer::Instance&, bool end_stream) {
+FilterDataStatus InjectFilter::decodeData(Buffer::Instance& data, bool end_stream) {
   ENVOY_LOG(trace,"InjectFilter::decodeData(end_stream={}) called on filter: {}", end_stream, PINT(this));
   if (state_ == State::Aborting) {
     return FilterDataStatus::StopIterationNoBuffer;
   }
-  return state_ == State::InjectRequestSent ? FilterDataStatus::StopIterationAndBuffer
-                                            : FilterDataStatus::Continue;
+  if (state_ != State::InjectRequestSent) {
+    return FilterDataStatus::Continue;
+  }
+
+  if (config_->max_buffer_bytes() > 0) {
+    const Buffer::Instance* buffered = decoder_callbacks_->decodingBuffer();
+    uint64_t buffered_bytes = data.length() + (buffered ? buffered->length() : 0);
+    if (buffered_bytes > config_->max_buffer_bytes()) {
+      return handleBufferOverflow();
+    }
+  }
+  return FilterDataStatus::StopIterationAndBuffer;
+}
+
+// request body outgrew max_buffer_bytes before the inject response
+// arrived. This chunk has already been read so it is always buffered
+// or dropped here; the configured action decides what happens next.
+FilterDataStatus InjectFilter::handleBufferOverflow() {
+  config_->stats().buffer_overflow_.inc();
+  switch (config_->buffer_overflow_action()) {
+  case InjectFilterConfig::BufferOverflowAction::Pause:
+    // stop reading from downstream until the inject response is handled
+    if (!reading_paused_) {
+      ENVOY_LOG(debug, "inject buffer limit reached, pausing downstream reads {}", PINT(this));
+      reading_paused_ = true;
+      decoder_callbacks_->onDecoderFilterAboveWriteBufferHighWatermark();
+    }
+    return FilterDataStatus::StopIterationAndBuffer;
+
+  case InjectFilterConfig::BufferOverflowAction::Abort:
+    ENVOY_LOG(debug, "inject buffer limit reached, aborting with 413 {}", PINT(this));
+    cancelInjectRequest();
+    state_ = State::Aborting;
+    Http::Utility::sendLocalReply(*decoder_callbacks_, false, Http::Code::PayloadTooLarge, "");
+    return FilterDataStatus::StopIterationNoBuffer;
+
+  case InjectFilterConfig::BufferOverflowAction::ErrorAction:
+    ENVOY_LOG(debug, "inject buffer limit reached, giving up on inject response {}", PINT(this));
+    cancelInjectRequest();
+    // as in decodeHeaders, stop a passthrough from continuing decoding
+    // itself; returning Continue below resumes iteration instead.
+    state_ = State::SendingInjectRequest;
+    inject_action_ = &config_->action_matcher().errorAction();
+    handleAction();
+    return state_ == State::WaitingForUpstream ? FilterDataStatus::Continue
+                                               : FilterDataStatus::StopIterationNoBuffer;
+  }
+  NOT_REACHED;
+}
+
+// Start connection setup to the route's upstream cluster now so it
+// overlaps the inject RPC rather than following it. Only done when the
+// cluster has no connection at all, connecting or ready: the pool
+// interface does not expose its clients, and upstream_cx_active counts
+// those of every worker's pool, this one's included. The pool must then
+// open a new connection: the queued stream is cancelled immediately,
+// which the cluster counts in upstream_rq_cancelled, and the new
+// connection carries on into the pool where the router picks it up.
+// Nothing is held by this filter, so there is nothing to release on
+// abort.
+void InjectFilter::speculativeConnect() {
+  Router::RouteConstSharedPtr route = decoder_callbacks_->route();
+  if (!route || !route->routeEntry()) {
+    return;
+  }
+  const Router::RouteEntry& entry = *route->routeEntry();
+  Upstream::ThreadLocalCluster* cluster = config_->cluster_manager().get(entry.clusterName());
+  if (!cluster || cluster->info()->stats().upstream_cx_active_.value() > 0) {
+    return;
+  }
+  ConnectionPool::Instance* pool =
+      config_->cluster_manager().httpConnPoolForCluster(entry.clusterName(), entry.priority(), nullptr);
+  if (!pool) {
+    return;
+  }
+  ENVOY_LOG(trace, "inject speculative connect to {} {}", entry.clusterName(), PINT(this));
+  ConnectionPool::Cancellable* pending = pool->newStream(speculative_connect_callbacks, speculative_connect_callbacks);
+  if (pending) {
+    pending->cancel();
+  }
+}
+
+// true if changing the named request header could change the route:
+// it is one of the configured route_headers, or none are configured.
+bool InjectFilter::affectsRouting(const Http::LowerCaseString& header_name) {
+  if (config_->route_headers().empty()) {
+    return true;
+  }
+  for (const Http::LowerCaseString& element : config_->route_headers()) {
+    if (element.get() == header_name.get()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void InjectFilter::resumeReading() {
+  if (reading_paused_) {
+    reading_paused_ = false;
+    decoder_callbacks_->onDecoderFilterBelowWriteBufferLowWatermark();
+  }
 }
 
 FilterTrailersStatus InjectFilter::decodeTrailers(HeaderMap&) {
@@ -320,46 +1011,34 @@ void InjectFilter::setDecoderFilterCallbacks(StreamDecoderFilterCallbacks& callb
 
 FilterHeadersStatus InjectFilter::encodeHeaders(HeaderMap& headers, bool) {
   ENVOY_LOG(trace,"InjectFilter: encodeHeaders entered {}", PINT(this));
-  if (state_ == State::NotTriggered) {
+  // nothing to apply: not triggered, or our own 413 abort reply
+  if (state_ == State::NotTriggered || inject_action_ == nullptr) {
     return FilterHeadersStatus::Continue;
   }
 
   if (inject_response_ != nullptr) {
     if (inject_action_->downstream_inject_any_) {
-      for (int i = 0; i < inject_response_->downstreamheaders_size(); ++i) {
-        const inject::Header& h = inject_response_->downstreamheaders(i);
-        Http::LowerCaseString lckey(h.key().c_str());
-        headers.addCopy(lckey, h.value());
+      for (const inject::Header& h : inject_response_->downstreamheaders()) {
+        injected_keys_.emplace_back(h.key());
+        headers.addReference(injected_keys_.back(), h.value());
         ENVOY_LOG(info, "downstream injecting header {}: {}", h.key(), h.value());
       }
-      for (int i = 0; i < inject_response_->downstreamremoveheadernames_size(); ++i) {
-        const std::string h = inject_response_->downstreamremoveheadernames(i);
-        Http::LowerCaseString lckey(h.c_str());
+      for (const std::string& h : inject_response_->downstreamremoveheadernames()) {
+        Http::LowerCaseString lckey(h);
         headers.remove(lckey);
       }
     } else {
-      std::map<std::string,std::string> inject_hdrs;
-      for (int i = 0; i < inject_response_->downstreamheaders_size(); ++i) {
-        const inject::Header& h = inject_response_->downstreamheaders(i);
-        inject_hdrs.insert(std::pair<std::string,std::string>(h.key(), h.value()));
-      }
-      std::map<std::string,std::string> remove_hdrs;
-      for (int i = 0; i < inject_response_->downstreamremoveheadernames_size(); ++i) {
-        const std::string h = inject_response_->downstreamremoveheadernames(i);
-        remove_hdrs.insert(std::pair<std::string,std::string>(h, h));
-      }
       for (const Http::LowerCaseString& element : inject_action_->downstream_inject_headers_) {
         ENVOY_LOG(info, "downstream injecting {}",element.get());
-        std::map<std::string,std::string>::iterator it = remove_hdrs.find(element.get());
-        if (it != remove_hdrs.end()) {
+        if (containsName(inject_response_->downstreamremoveheadernames(), element.get())) {
           headers.remove(element);
           continue;
         }
-        it = inject_hdrs.find(element.get());
-        if (it != inject_hdrs.end()) {
+        const std::string* value = findInjectHeader(inject_response_->downstreamheaders(), element.get());
+        if (value) {
           headers.remove(element);
-          if (it->second != "") {
-            headers.addReferenceKey(element, it->second);
+          if (!value->empty()) {
+            headers.addReference(element, *value);
           }
         }
       }
@@ -389,7 +1068,56 @@ void InjectFilter::setEncoderFilterCallbacks(StreamEncoderFilterCallbacks& callb
 
 // FIXME: move these cookie fcns into envoy cookie utils if wanted
 
-static const Http::LowerCaseString cookie_hdr_name{"cookie"};
+bool InjectFilter::findCookieValue(const Http::HeaderMap& headers, const std::string& cookie_name,
+                                   const char*& value, size_t& length) {
+  struct CookieSearch {
+    const std::string& name_;
+    const char* value_;
+    size_t length_;
+    bool found_;
+  } search{cookie_name, nullptr, 0, false};
+
+  headers.iterate([](const HeaderEntry& header, void* context) -> void {
+      CookieSearch& search = *static_cast<CookieSearch*>(context);
+      if (search.found_ || !(header.key() == cookie_hdr_name.get().c_str())) {
+        return;
+      }
+      const char* cookie = header.value().c_str();
+      const char* end = cookie + header.value().size();
+      // each "name=value" between semicolons, leading spaces ignored
+      while (cookie < end) {
+        const char* cookie_end = static_cast<const char*>(memchr(cookie, ';', end - cookie));
+        if (cookie_end == nullptr) {
+          cookie_end = end;
+        }
+        const char* name = cookie;
+        while (name < cookie_end && *name == ' ') {
+          name++;
+        }
+        const char* equals = static_cast<const char*>(memchr(name, '=', cookie_end - name));
+        if (equals != nullptr && static_cast<size_t>(equals - name) == search.name_.size()
+            && memcmp(name, search.name_.data(), search.name_.size()) == 0) {
+          search.value_ = equals + 1;
+          search.length_ = cookie_end - search.value_;
+          // cookie values may be wrapped in double quotes
+          if (search.length_ >= 2 && search.value_[0] == '"' && search.value_[search.length_ - 1] == '"') {
+            search.value_++;
+            search.length_ -= 2;
+          }
+          search.found_ = true;
+          return;
+        }
+        cookie = cookie_end + 1;
+      }
+    }, &search);
+
+  if (!search.found_) {
+    return false;
+  }
+  value = search.value_;
+  length = search.length_;
+  return true;
+}
 
 // Removes the cookie header from the headers and replaces it with one
 // whose value does not include the named cookie(s).
@@ -474,6 +1202,14 @@ void InjectFilter::removeNamedCookie(const std::string& cookie_name, std::string
 }
 
 
+InjectHeaderData::InjectHeaderData(const Json::Object& config)
+    : name_(config.getString("name")), value_(config.getString("value", "")),
+      regex_pattern_(value_, std::regex::optimize), is_regex_(config.getBoolean("regex", false)) {}
+
+InjectHeaderData::InjectHeaderData(const inject::InjectConfig::HeaderMatch& config)
+    : name_(config.name()), value_(config.value()), regex_pattern_(value_, std::regex::optimize),
+      is_regex_(config.regex()) {}
+
 // FIXME: move these match fcns into envoy Router::ConfigUtility
 
 /**
@@ -483,10 +1219,10 @@ void InjectFilter::removeNamedCookie(const std::string& cookie_name, std::string
  * @return true one or more for the config_headers match a request_headers entry
  */
 bool InjectFilter::matchAnyHeaders(const Http::HeaderMap& request_headers,
-                                   const std::vector<Router::ConfigUtility::HeaderData>& config_headers) {
+                                   const std::vector<InjectHeaderData>& config_headers) {
 
   if (!config_headers.empty()) {
-    for (const Router::ConfigUtility::HeaderData& config_header : config_headers) {
+    for (const InjectHeaderData& config_header : config_headers) {
       if (matchHeader(request_headers, config_header)) {
         return true;
       }
@@ -502,7 +1238,7 @@ bool InjectFilter::matchAnyHeaders(const Http::HeaderMap& request_headers,
  * @return true if config_header matches one of the request_headers
  */
 bool InjectFilter::matchHeader(const Http::HeaderMap& request_headers,
-                               const Router::ConfigUtility::HeaderData& config_header) {
+                               const InjectHeaderData& config_header) {
   const Http::HeaderEntry* header = request_headers.get(config_header.name_);
   if (header == nullptr) {
     return false;
@@ -511,7 +1247,7 @@ bool InjectFilter::matchHeader(const Http::HeaderMap& request_headers,
 }
 
  bool InjectFilter::matchHeader(const Http::HeaderEntry& request_header,
-                                const Router::ConfigUtility::HeaderData& config_header) {
+                                const InjectHeaderData& config_header) {
   if (config_header.value_.empty()) {
     return true;
   }
@@ -1,19 +1,34 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <regex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <map>
 
+#include "envoy/common/time.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/http/conn_pool.h"
 #include "envoy/http/filter.h"
+#include "envoy/json/json_object.h"
 #include "envoy/local_info/local_info.h"
+#include "envoy/router/router.h"
 #include "envoy/runtime/runtime.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/thread_local/thread_local.h"
+#include "envoy/tracing/http_tracer.h"
 #include "envoy/upstream/cluster_manager.h"
 #include "envoy/grpc/async_client.h"
 #include "common/grpc/async_client_impl.h"
-#include "common/router/config_utility.h"
 #include "inject.pb.h"
+#include "inject_capture.h"
 
 #include "common/common/assert.h"
 #include "common/http/header_map_impl.h"
@@ -22,6 +37,45 @@
 namespace Envoy {
 namespace Http {
 
+/**
+ * All inject filter stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_INJECT_STATS(COUNTER, GAUGE, TIMER)                                                   \
+  COUNTER(triggered)                                                                              \
+  COUNTER(antitriggered)                                                                          \
+  COUNTER(not_triggered)                                                                          \
+  COUNTER(rpc_success)                                                                            \
+  COUNTER(rpc_failure)                                                                            \
+  COUNTER(rpc_timeout)                                                                            \
+  COUNTER(rpc_bytes_sent)                                                                         \
+  COUNTER(rpc_bytes_received)                                                                     \
+  COUNTER(result_other)                                                                           \
+  COUNTER(action_passthrough)                                                                     \
+  COUNTER(action_abort)                                                                           \
+  COUNTER(buffer_overflow)                                                                        \
+  COUNTER(config_reload)                                                                          \
+  COUNTER(config_reload_failed)                                                                   \
+  COUNTER(capture_records)                                                                        \
+  COUNTER(capture_dropped)                                                                        \
+  COUNTER(memo_hit)                                                                               \
+  COUNTER(memo_miss)                                                                              \
+  COUNTER(route_disabled)                                                                         \
+  COUNTER(route_config)                                                                           \
+  COUNTER(shed)                                                                                   \
+  COUNTER(rpc_over_limit)                                                                         \
+  GAUGE  (rpc_active)                                                                             \
+  TIMER  (rpc_latency)                                                                            \
+  TIMER  (added_latency)
+// clang-format on
+
+/**
+ * Struct definition for all inject filter stats. @see stats_macros.h
+ */
+struct InjectStats {
+  ALL_INJECT_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT, GENERATE_TIMER_STRUCT)
+};
+
 
 class InjectAction {
 public:
@@ -34,13 +88,15 @@ public:
               bool downstream_inject_any,
               std::vector<Http::LowerCaseString>& downstream_remove_headers,
               bool use_rpc_response,
-              int response_code, std::map<std::string,std::string>& response_headers, std::string response_body):
+              int response_code, std::map<std::string,std::string>& response_headers, std::string response_body,
+              bool redo_routing):
     result_(result), action_(action),
     upstream_inject_headers_(upstream_inject_headers), upstream_inject_any_(upstream_inject_any),
     upstream_remove_headers_(upstream_remove_headers), upstream_remove_cookie_names_(upstream_remove_cookie_names),
     downstream_inject_headers_(downstream_inject_headers), downstream_inject_any_(downstream_inject_any),
     downstream_remove_headers_(downstream_remove_headers),
-    use_rpc_response_(use_rpc_response), response_code_(response_code), response_headers_(response_headers), response_body_(response_body) { }
+    use_rpc_response_(use_rpc_response), response_code_(response_code), response_headers_(response_headers), response_body_(response_body),
+    redo_routing_(redo_routing) { }
 
   const std::vector<std::string> result_;
   const std::string action_;
@@ -55,6 +111,7 @@ public:
   const int response_code_;
   const std::map<std::string,std::string> response_headers_;
   const std::string response_body_;
+  const bool redo_routing_;
 };
 
 
@@ -74,7 +131,7 @@ public:
                            empty_lc_str_vec, empty_str_vec,
                            empty_lc_str_vec, false,
                            empty_lc_str_vec, false,
-                           500, empty_hdrs, ""));
+                           500, empty_hdrs, "", false));
 
   }
 
@@ -102,6 +159,23 @@ public:
     return *(iaPair->second);
   }
 
+  // the action configured for exactly this result, nullptr if none
+  const InjectAction* lookup(const std::string& result) const {
+    auto iaPair = action_map_.find(result);
+    return iaPair == action_map_.end() ? nullptr : iaPair->second;
+  }
+
+  const std::vector<InjectAction>& actions() const { return actions_; }
+
+  // every result string configured to select an action
+  std::vector<std::string> results() const {
+    std::vector<std::string> results;
+    for (const auto& iaPair : action_map_) {
+      results.push_back(iaPair.first);
+    }
+    return results;
+  }
+
   const InjectAction& errorAction() const {
     auto iaPair = action_map_.find("local.error");
     if (iaPair != action_map_.end()) {
@@ -125,69 +199,428 @@ public:
   std::map<std::string,InjectAction*> action_map_;
 };
 
+typedef std::unique_ptr<const InjectActionMatcher> InjectActionMatcherPtr;
+
+/**
+ * Settings of the adaptive limit on a worker's outstanding inject RPCs.
+ */
+struct InjectConcurrencyLimitConfig {
+  // what a request over the limit does instead of the RPC: go on
+  // without injection, or take the local.error action
+  enum class OverLimitAction { Passthrough, Error };
+
+  uint32_t initial_limit_;
+  uint32_t min_limit_;
+  uint32_t max_limit_;
+  std::chrono::milliseconds sample_window_;
+  // the latency baseline is re-measured every this many windows
+  uint32_t baseline_windows_;
+  // how far above the baseline latency may go before the limit shrinks
+  double tolerance_;
+  OverLimitAction over_limit_action_;
+};
+
+typedef std::shared_ptr<const InjectConcurrencyLimitConfig> InjectConcurrencyLimitConfigConstSharedPtr;
+
+/**
+ * Gradient concurrency limit for one worker's inject RPCs. At the end of
+ * each sample window the mean RPC latency in it is compared with a
+ * baseline, the lowest window mean of the last baseline_windows windows:
+ *
+ *   gradient = clamp(tolerance * baseline / sample, 0.5, 1)
+ *   limit = clamp(gradient * limit + sqrt(limit), min_limit, max_limit)
+ *
+ * While the injector answers near its baseline the limit grows by about
+ * sqrt(limit) a window; when it slows the limit shrinks towards what it
+ * serves at that speed, at most halving per window. Re-measuring the
+ * baseline lets a lasting change in the injector's speed become the new
+ * normal.
+ *
+ * Worker only, except limit() which the admin handler reads.
+ */
+class InjectConcurrencyLimiter {
+public:
+  // whether an RPC may start with active ones already outstanding
+  bool admit(uint64_t active, const InjectConcurrencyLimitConfig& config);
+
+  // an RPC finished (response, error or timeout) after latency
+  void record(std::chrono::microseconds latency, MonotonicTime now, const InjectConcurrencyLimitConfig& config);
+
+  // 0 until the first admit()
+  uint32_t limit() const { return limit_; }
+
+private:
+  void update(const InjectConcurrencyLimitConfig& config);
+
+  std::atomic<uint32_t> limit_{};
+  MonotonicTime window_start_{};
+  uint64_t window_samples_{};
+  std::chrono::microseconds window_latency_{};
+  // 0 until the first window ends
+  std::chrono::microseconds baseline_{};
+  std::chrono::microseconds next_baseline_{};
+  uint32_t baseline_age_{};
+};
+
+/**
+ * A trigger or antitrigger header constraint: the fields of
+ * Router::ConfigUtility::HeaderData, which only reads JSON, buildable
+ * from the typed config's HeaderMatch as well.
+ */
+struct InjectHeaderData {
+  InjectHeaderData(const Json::Object& config);
+  InjectHeaderData(const inject::InjectConfig::HeaderMatch& config);
+
+  const Http::LowerCaseString name_;
+  const std::string value_;
+  const std::regex regex_pattern_;
+  const bool is_regex_;
+};
+
 /**
  * Global configuration for the Injector
  */
 class InjectFilterConfig {
 public:
+  // what to do when a request body outgrows max_buffer_bytes while the
+  // inject RPC is outstanding
+  enum class BufferOverflowAction { Pause, Abort, ErrorAction };
 
-  InjectFilterConfig(std::vector<Router::ConfigUtility::HeaderData>& trigger_headers,
+  InjectFilterConfig(std::vector<InjectHeaderData>& trigger_headers,
                      std::vector<std::string>& trigger_cookie_names,
-                     std::vector<Router::ConfigUtility::HeaderData>& antitrigger_headers,
+                     std::vector<InjectHeaderData>& antitrigger_headers,
                      bool always_triggered,
                      std::vector<Http::LowerCaseString>& include_headers,
                      bool include_all_headers,
+                     std::vector<Http::LowerCaseString>& route_headers,
                      std::map<std::string,std::string> params,
                      Upstream::ClusterManager& cluster_mgr,
                      const std::string cluster_name,
                      int64_t timeout_ms,
-                     const InjectActionMatcher& action_matcher):
+                     uint64_t max_buffer_bytes,
+                     BufferOverflowAction buffer_overflow_action,
+                     bool speculative_connect,
+                     InjectCaptureSharedPtr capture,
+                     std::chrono::milliseconds memo_ttl,
+                     uint64_t memo_max_entries,
+                     InjectActionMatcherPtr&& action_matcher,
+                     Stats::Scope& scope,
+                     const std::string& stats_prefix):
     trigger_headers_(trigger_headers), trigger_cookie_names_(trigger_cookie_names), antitrigger_headers_(antitrigger_headers),
     always_triggered_(always_triggered), include_headers_(include_headers), include_all_headers_(include_all_headers),
+    route_headers_(route_headers),
     params_(params), cluster_name_(cluster_name), timeout_ms_(timeout_ms),
-    cluster_mgr_(cluster_mgr), action_matcher_(action_matcher),
-    method_descriptor_(*Protobuf::DescriptorPool::generated_pool()->FindMethodByName("inject.InjectService.InjectHeaders")) {
+    max_buffer_bytes_(max_buffer_bytes), buffer_overflow_action_(buffer_overflow_action),
+    speculative_connect_(speculative_connect), capture_(capture), memo_ttl_(memo_ttl),
+    memo_max_entries_(memo_max_entries), cluster_mgr_(cluster_mgr),
+    action_matcher_(std::move(action_matcher)),
+    stats_prefix_(stats_prefix),
+    method_descriptor_(*Protobuf::DescriptorPool::generated_pool()->FindMethodByName("inject.InjectService.InjectHeaders")),
+    stats_{ALL_INJECT_STATS(POOL_COUNTER_PREFIX(scope, stats_prefix), POOL_GAUGE_PREFIX(scope, stats_prefix),
+                            POOL_TIMER_PREFIX(scope, stats_prefix))} {
     ASSERT(Protobuf::DescriptorPool::generated_pool()->FindMethodByName("inject.InjectService.InjectHeaders"))
+    // counters for configured results are looked up per response, so
+    // resolve them once here
+    for (const std::string& result : action_matcher_->results()) {
+      result_counters_[result] = &scope.counter(stats_prefix + "result." + result);
+    }
+  }
+
+  // a route config: base with its own cluster, timeout and actions
+  InjectFilterConfig(const InjectFilterConfig& base, const std::string& cluster_name, int64_t timeout_ms,
+                     InjectActionMatcherPtr&& action_matcher, Stats::Scope& scope):
+    trigger_headers_(base.trigger_headers_), trigger_cookie_names_(base.trigger_cookie_names_),
+    antitrigger_headers_(base.antitrigger_headers_), always_triggered_(base.always_triggered_),
+    include_headers_(base.include_headers_), include_all_headers_(base.include_all_headers_),
+    route_headers_(base.route_headers_), params_(base.params_), cluster_name_(cluster_name),
+    timeout_ms_(timeout_ms), max_buffer_bytes_(base.max_buffer_bytes_),
+    buffer_overflow_action_(base.buffer_overflow_action_), speculative_connect_(base.speculative_connect_),
+    capture_(base.capture_), memo_ttl_(base.memo_ttl_), memo_max_entries_(base.memo_max_entries_),
+    cluster_mgr_(base.cluster_mgr_), action_matcher_(std::move(action_matcher)),
+    stats_prefix_(base.stats_prefix_), method_descriptor_(base.method_descriptor_), stats_(base.stats_),
+    runtime_(base.runtime_), shed_runtime_key_(base.shed_runtime_key_),
+    shed_default_percent_(base.shed_default_percent_), shed_action_(base.shed_action_),
+    concurrency_limit_(base.concurrency_limit_) {
+    for (const std::string& result : action_matcher_->results()) {
+      result_counters_[result] = &scope.counter(stats_prefix_ + "result." + result);
+    }
   }
 
-  const std::vector<Router::ConfigUtility::HeaderData>& trigger_headers() { return trigger_headers_; }
+  // Routes tune the filter through their opaque_config, under
+  // "inject.<stat_prefix>.<key>" for a filter with a stat_prefix, else
+  // or failing that "inject.<key>": "disabled" set to "true" skips the
+  // filter and "config" names one of route_configs to use instead of
+  // this one. Set once while the config is built.
+  void setRouteConfigs(const std::string& filter_stat_prefix,
+                       std::map<std::string, std::shared_ptr<InjectFilterConfig>>&& route_configs);
+
+  // what a shed request does instead of the inject RPC: go on without
+  // injection, or take the local.error action
+  enum class ShedAction { Passthrough, Error };
+
+  // Triggered requests send the inject RPC runtime_key percent of the
+  // time, default_percent while the key is unset; the rest are shed.
+  // Set once while the config is built, before any route configs.
+  void setShedding(Runtime::Loader& runtime, const std::string& runtime_key, uint64_t default_percent,
+                   ShedAction action) {
+    runtime_ = &runtime;
+    shed_runtime_key_ = runtime_key;
+    shed_default_percent_ = default_percent;
+    shed_action_ = action;
+  }
+
+  // whether this triggered request should skip its inject RPC
+  bool shed() const {
+    return runtime_ && !runtime_->snapshot().featureEnabled(shed_runtime_key_, shed_default_percent_);
+  }
+  ShedAction shed_action() const { return shed_action_; }
+
+  // Bound each worker's outstanding RPCs with an InjectConcurrencyLimiter.
+  // Set once while the config is built, before any route configs.
+  void setConcurrencyLimit(InjectConcurrencyLimitConfigConstSharedPtr concurrency_limit) {
+    concurrency_limit_ = concurrency_limit;
+  }
+  // nullptr if RPCs are not limited
+  const InjectConcurrencyLimitConfig* concurrency_limit() const { return concurrency_limit_.get(); }
+
+  bool routeDisabled(const Router::RouteEntry& route) const;
+  // the route config route names, nullptr if none
+  const std::shared_ptr<InjectFilterConfig>* routeConfig(const Router::RouteEntry& route) const;
+
+  const std::vector<InjectHeaderData>& trigger_headers() { return trigger_headers_; }
   const std::vector<std::string>& trigger_cookie_names() { return trigger_cookie_names_; }
-  const std::vector<Router::ConfigUtility::HeaderData>& antitrigger_headers() { return antitrigger_headers_; }
+  const std::vector<InjectHeaderData>& antitrigger_headers() { return antitrigger_headers_; }
   bool always_triggered() { return always_triggered_; }
   const std::vector<Http::LowerCaseString>& include_headers() { return include_headers_; }
   bool include_all_headers() { return include_all_headers_; }
+  const std::vector<Http::LowerCaseString>& route_headers() { return route_headers_; }
   std::map<std::string,std::string>& params() { return params_; }
 
+  const std::string& cluster_name() { return cluster_name_; }
   int64_t timeout_ms() { return timeout_ms_; }
+  uint64_t max_buffer_bytes() { return max_buffer_bytes_; } // 0 is unbounded
+  BufferOverflowAction buffer_overflow_action() { return buffer_overflow_action_; }
+  bool speculative_connect() { return speculative_connect_; }
+  InjectCapture* capture() { return capture_.get(); } // nullptr if not capturing
+  std::chrono::milliseconds memo_ttl() { return memo_ttl_; } // 0 if results are not reused
+  uint64_t memo_max_entries() { return memo_max_entries_; }
+  // unique to this config: each reload and each route config gets its
+  // own, so their memo entries are kept apart
+  uint64_t generation() const { return generation_; }
+  Upstream::ClusterManager& cluster_manager() { return cluster_mgr_; }
+  InjectStats& stats() { return stats_; }
+  const std::string& stats_prefix() { return stats_prefix_; }
+
+  // counter for the given inject result, result_other if not configured
+  Stats::Counter& resultCounter(const std::string& result) {
+    auto it = result_counters_.find(result);
+    return it == result_counters_.end() ? stats_.result_other_ : *it->second;
+  }
 
   std::unique_ptr<Grpc::AsyncClientImpl<inject::InjectRequest, inject::InjectResponse>> inject_client() {
     return std::unique_ptr<Grpc::AsyncClientImpl<inject::InjectRequest, inject::InjectResponse>>(new Grpc::AsyncClientImpl<inject::InjectRequest,
                                                                                                  inject::InjectResponse>(cluster_mgr_, cluster_name_));
   }
   const google::protobuf::MethodDescriptor& method_descriptor() { return method_descriptor_; }
-  const InjectActionMatcher& action_matcher() { return action_matcher_; }
+  const InjectActionMatcher& action_matcher() { return *action_matcher_; }
 
  private:
 
-  std::vector<Router::ConfigUtility::HeaderData> trigger_headers_;
+  std::vector<InjectHeaderData> trigger_headers_;
   std::vector<std::string> trigger_cookie_names_;
-  std::vector<Router::ConfigUtility::HeaderData> antitrigger_headers_;
+  std::vector<InjectHeaderData> antitrigger_headers_;
   const bool always_triggered_;
   std::vector<Http::LowerCaseString> include_headers_;
   const bool include_all_headers_;
+  std::vector<Http::LowerCaseString> route_headers_;
   std::map<std::string,std::string> params_;
   const std::string cluster_name_;
   const int64_t timeout_ms_;
+  const uint64_t max_buffer_bytes_;
+  const BufferOverflowAction buffer_overflow_action_;
+  const bool speculative_connect_;
+  const InjectCaptureSharedPtr capture_;
+  const std::chrono::milliseconds memo_ttl_;
+  const uint64_t memo_max_entries_;
+  const uint64_t generation_{nextGeneration()};
   Upstream::ClusterManager& cluster_mgr_;
-  const InjectActionMatcher& action_matcher_;
+  const InjectActionMatcherPtr action_matcher_;
+  const std::string stats_prefix_;
   const google::protobuf::MethodDescriptor& method_descriptor_;
+  InjectStats stats_;
+  static uint64_t nextGeneration();
+
+  std::map<std::string,Stats::Counter*> result_counters_;
+  // opaque_config keys, most specific first
+  std::vector<std::string> route_disabled_keys_{"inject.disabled"};
+  std::vector<std::string> route_config_keys_{"inject.config"};
+  std::map<std::string, std::shared_ptr<InjectFilterConfig>> route_configs_;
+  // nullptr unless shedding is configured
+  Runtime::Loader* runtime_{};
+  std::string shed_runtime_key_;
+  uint64_t shed_default_percent_{100};
+  ShedAction shed_action_{ShedAction::Passthrough};
+  InjectConcurrencyLimitConfigConstSharedPtr concurrency_limit_;
 };
 
 typedef std::shared_ptr<InjectFilterConfig> InjectFilterConfigSharedPtr;
 
+/**
+ * Inject RPC latency histogram with power of two microsecond buckets:
+ * bucket 0 holds 0us and bucket i holds [2^(i-1), 2^i) us, the last one
+ * also taking anything longer. Written by one worker and read by the
+ * admin handler on the main thread.
+ */
+class InjectLatencyHistogram {
+public:
+  static const size_t BUCKETS = 25;
+  typedef std::array<uint64_t, BUCKETS> Counts;
+
+  void record(std::chrono::microseconds latency);
+
+  // add this histogram's bucket counts to counts
+  void addTo(Counts& counts) const;
+
+  // upper bound in us of the bucket holding quantile q, 0 if empty
+  static uint64_t quantile(const Counts& counts, double q);
+
+private:
+  std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+};
+
+typedef std::shared_ptr<const inject::InjectResponse> InjectResponseConstSharedPtr;
+
+/**
+ * Inject responses remembered per downstream connection by config
+ * generation and trigger values, so later streams on the same
+ * connection and config skip the RPC. Entries expire after the
+ * configured TTL, and a connection's entries go when it closes.
+ */
+class InjectConnectionMemo {
+public:
+  // the live response for key on the connection, nullptr if none
+  InjectResponseConstSharedPtr lookup(uint64_t connection_id, const std::string& key, MonotonicTime now);
+
+  // remember response for ttl, dropping expired entries and then the
+  // oldest to stay within max_entries. True if this is the first entry
+  // for the connection since it was last erased, so its close should
+  // now be watched.
+  bool insert(uint64_t connection_id, const std::string& key, InjectResponseConstSharedPtr response,
+              MonotonicTime now, std::chrono::milliseconds ttl, uint64_t max_entries);
+
+  // forget everything remembered for a closed connection
+  void eraseConnection(uint64_t connection_id);
+
+  size_t size() const { return size_; }
+
+private:
+  struct Entry {
+    InjectResponseConstSharedPtr response_;
+    MonotonicTime expiry_;
+    std::list<std::pair<uint64_t, std::string>>::iterator order_;
+  };
+  typedef std::unordered_map<std::string, Entry> ConnectionEntries;
+
+  void erase(ConnectionEntries& entries, ConnectionEntries::iterator entry);
+
+  // a connection stays here, possibly with no entries, until erased, so
+  // its close is watched only once
+  std::unordered_map<uint64_t, ConnectionEntries> connections_;
+  // connection ids and keys, oldest first; with one TTL this is also
+  // expiry order
+  std::list<std::pair<uint64_t, std::string>> order_;
+  size_t size_{};
+};
+
+/**
+ * Live inject state for one worker, kept across config reloads so the
+ * admin handler can report what each worker is doing.
+ */
+struct InjectWorkerState {
+  std::atomic<uint64_t> rpc_active_{};
+  InjectLatencyHistogram rpc_latency_;
+  InjectConcurrencyLimiter limiter_;
+  // worker only, not reported
+  InjectConnectionMemo memo_;
+};
+
+typedef std::shared_ptr<InjectWorkerState> InjectWorkerStateSharedPtr;
+
+/**
+ * The InjectWorkerState of every thread a filter's config is published
+ * to, keyed by the thread's dispatcher.
+ */
+class InjectWorkerStates {
+public:
+  // any thread: the state for the thread running dispatcher
+  InjectWorkerStateSharedPtr get(Event::Dispatcher& dispatcher);
+
+  // any thread: the states created so far, in creation order
+  std::vector<InjectWorkerStateSharedPtr> all();
+
+private:
+  std::mutex lock_;
+  std::vector<std::pair<const Event::Dispatcher*, InjectWorkerStateSharedPtr>> states_;
+};
+
+typedef std::shared_ptr<InjectWorkerStates> InjectWorkerStatesSharedPtr;
+
+/**
+ * A worker's view of the current config snapshot. A fresh one is
+ * installed on every worker each time the config is replaced.
+ *
+ * config_ points at the shared snapshot but has a reference count of its
+ * own, holding one reference to the snapshot until the last of this
+ * worker's filters lets go. Every filter takes a reference, so this keeps
+ * the per-request refcount traffic on a cache line only this worker
+ * touches instead of one shared by all workers.
+ */
+class ThreadLocalInjectConfig : public ThreadLocal::ThreadLocalObject {
+public:
+  ThreadLocalInjectConfig(InjectFilterConfigSharedPtr config, InjectWorkerStateSharedPtr worker_state)
+    : config_(config.get(), [config](InjectFilterConfig*) {}), worker_state_(worker_state) {}
+
+  // ThreadLocal::ThreadLocalObject
+  void shutdown() override {}
+
+  const InjectFilterConfigSharedPtr config_;
+  const InjectWorkerStateSharedPtr worker_state_;
+};
+
+/**
+ * Publishes InjectFilterConfig snapshots to the workers, RCU style. The
+ * main thread builds a new immutable snapshot and swaps it into every
+ * worker's thread local slot. Filters take their own reference to the
+ * snapshot current at creation time so in-flight requests finish on the
+ * config they started with; a replaced snapshot is freed when the last
+ * such request is destroyed.
+ */
+class InjectFilterConfigProvider {
+public:
+  InjectFilterConfigProvider(ThreadLocal::Instance& tls, InjectFilterConfigSharedPtr config);
+
+  // worker thread: the snapshot new filters should use
+  InjectFilterConfigSharedPtr config();
+
+  // worker thread: live state shared by this worker's filters
+  InjectWorkerStateSharedPtr workerState();
+
+  // main thread: replace the snapshot on every worker
+  void update(InjectFilterConfigSharedPtr config);
+
+  const InjectWorkerStatesSharedPtr& workerStates() { return worker_states_; }
+
+private:
+  InjectWorkerStatesSharedPtr worker_states_;
+  ThreadLocal::SlotPtr tls_slot_;
+};
+
+typedef std::shared_ptr<InjectFilterConfigProvider> InjectFilterConfigProviderSharedPtr;
+
 class InjectFilter : Logger::Loggable<Logger::Id::filter>, public StreamFilter, Grpc::AsyncRequestCallbacks<inject::InjectResponse> {
 public:
- InjectFilter(InjectFilterConfigSharedPtr config): config_(config) {}
+ InjectFilter(InjectFilterConfigSharedPtr config, InjectWorkerStateSharedPtr worker_state = nullptr)
+   : config_(config), worker_state_(worker_state) {}
 
   // Http::StreamFilterBase
   void onDestroy() override;
@@ -215,30 +648,72 @@ public:
   static void removeNamedCookie(const std::string& cookie_name, Http::HeaderMap& headers);
   static void removeNamedCookie(const std::string& cookie_name, std::string& cookie_hdr_value);
 
+  // Finds the named cookie's value in the cookie header(s) without
+  // copying: on success value/length point into the header map. Parses
+  // like Http::Utility::parseCookieValue, which allocates.
+  static bool findCookieValue(const Http::HeaderMap& headers, const std::string& cookie_name,
+                              const char*& value, size_t& length);
+
   static bool matchAnyHeaders(const Http::HeaderMap& request_headers,
-                              const std::vector<Router::ConfigUtility::HeaderData>& config_headers);
+                              const std::vector<InjectHeaderData>& config_headers);
 
   static bool matchHeader(const Http::HeaderMap& request_headers,
-                          const Router::ConfigUtility::HeaderData& config_header);
+                          const InjectHeaderData& config_header);
 
   static bool matchHeader(const Http::HeaderEntry& request_header,
-                          const Router::ConfigUtility::HeaderData& config_header);
+                          const InjectHeaderData& config_header);
 
 private:
 
   void handleAction();
   void handleAbortAction();
   void handlePassThroughAction();
+  FilterDataStatus handleBufferOverflow();
+  void resumeReading();
+  void speculativeConnect();
+  bool affectsRouting(const Http::LowerCaseString& header_name);
+  FilterHeadersStatus skipInjectRequest(HeaderMap& headers, bool error_action);
+  // sample: the RPC's latency says how the injector is doing (not so
+  // for a cancelled one)
+  void onRpcComplete(bool sample = true);
+  void cancelInjectRequest();
+  void captureRpc(const std::string& result, const inject::InjectResponse* response,
+                  Grpc::Status::GrpcStatus status);
+  void startInjectSpan();
+  bool memoKey(const HeaderMap& headers, std::string& key);
 
   InjectFilterConfigSharedPtr config_;
-  StreamDecoderFilterCallbacks* decoder_callbacks_;
-  StreamEncoderFilterCallbacks* encoder_callbacks_;
+  InjectWorkerStateSharedPtr worker_state_;
+  StreamDecoderFilterCallbacks* decoder_callbacks_{};
+  StreamEncoderFilterCallbacks* encoder_callbacks_{};
   State state_{State::NotTriggered};
   std::unique_ptr<Grpc::AsyncClientImpl<inject::InjectRequest, inject::InjectResponse>> client_;
   Grpc::AsyncRequest* req_{};
-  HeaderMap* upstream_headers_;
-  std::unique_ptr<inject::InjectResponse> inject_response_;
-  const InjectAction* inject_action_;
+  HeaderMap* upstream_headers_{};
+  // Injected header values are added to the request/response header
+  // maps by reference into inject_response_ rather than copied (signed
+  // tokens can be several KB). Keys from the response that are not in
+  // the config are kept in injected_keys_ for the same reason. Both
+  // live as long as the stream's header maps are in use.
+  // The response may be shared with the connection memo and the other
+  // streams it serves.
+  InjectResponseConstSharedPtr inject_response_;
+  std::list<Http::LowerCaseString> injected_keys_;
+  // null until an action is chosen; a buffer limit abort replies
+  // without one
+  const InjectAction* inject_action_{};
+  bool reading_paused_{};
+  bool rpc_outstanding_{};
+  std::chrono::steady_clock::time_point rpc_start_;
+  Stats::TimespanPtr rpc_latency_;
+  Stats::TimespanPtr added_latency_;
+  // child of the stream's span around the InjectHeaders RPC
+  Tracing::SpanPtr inject_span_;
+  // the inject request, kept only if this RPC is sampled for capture
+  std::unique_ptr<inject::InjectRequest> capture_request_;
+  int64_t capture_start_us_{};
+  // key under which this stream's response is remembered, empty if not
+  std::string memo_key_;
 };
 
 } // Http
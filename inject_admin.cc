@@ -0,0 +1,197 @@
+#include "inject_admin.h"
+
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "envoy/upstream/resource_manager.h"
+
+namespace Envoy {
+namespace Server {
+
+namespace {
+
+struct InjectAdminRegistry {
+  Admin* admin_{};
+  std::list<std::weak_ptr<Http::InjectFilterConfigProvider>> providers_;
+};
+
+InjectAdminRegistry& registry() {
+  static InjectAdminRegistry* registry = new InjectAdminRegistry();
+  return *registry;
+}
+
+std::string jsonString(const std::string& value) {
+  std::string out = "\"";
+  for (char c : value) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        out += escaped;
+      } else {
+        out += c;
+      }
+    }
+  }
+  return out + "\"";
+}
+
+template <class T> std::string jsonStringList(const std::vector<T>& values) {
+  std::string out = "[";
+  for (const T& value : values) {
+    out += (out.size() > 1 ? ", " : "") + jsonString(value);
+  }
+  return out + "]";
+}
+
+std::string jsonStringList(const std::vector<Http::LowerCaseString>& values) {
+  std::vector<std::string> strings;
+  for (const Http::LowerCaseString& value : values) {
+    strings.push_back(value.get());
+  }
+  return jsonStringList(strings);
+}
+
+const char* circuitState(Upstream::Resource& resource) { return resource.canCreate() ? "closed" : "open"; }
+
+void dumpCircuit(Http::InjectFilterConfig& config, std::stringstream& out) {
+  Upstream::ThreadLocalCluster* cluster = config.cluster_manager().get(config.cluster_name());
+  if (!cluster) {
+    out << "\"missing\"";
+    return;
+  }
+  Upstream::ResourceManager& resources =
+      cluster->info()->resourceManager(Upstream::ResourcePriority::Default);
+  out << "{\"connections\": \"" << circuitState(resources.connections()) << "\", "
+      << "\"pending_requests\": \"" << circuitState(resources.pendingRequests()) << "\", "
+      << "\"requests\": \"" << circuitState(resources.requests()) << "\", "
+      << "\"retries\": \"" << circuitState(resources.retries()) << "\"}";
+}
+
+void dumpAction(const Http::InjectActionMatcher& matcher, const Http::InjectAction& action,
+                std::stringstream& out) {
+  // only the results still selecting this action; a later action may
+  // have taken over some of them (e.g. local.any)
+  std::vector<std::string> results;
+  for (const std::string& result : action.result_) {
+    if (matcher.lookup(result) == &action) {
+      results.push_back(result);
+    }
+  }
+  if (results.empty()) {
+    return;
+  }
+  out << "{\"result\": " << jsonStringList(results) << ", \"action\": " << jsonString(action.action_);
+  if (action.action_ == "passthrough" || action.action_ == "dynamic") {
+    out << ", \"upstream_inject_headers\": " << jsonStringList(action.upstream_inject_headers_)
+        << ", \"upstream_inject_any\": " << (action.upstream_inject_any_ ? "true" : "false")
+        << ", \"upstream_remove_headers\": " << jsonStringList(action.upstream_remove_headers_)
+        << ", \"upstream_remove_cookie_names\": " << jsonStringList(action.upstream_remove_cookie_names_)
+        << ", \"downstream_inject_headers\": " << jsonStringList(action.downstream_inject_headers_)
+        << ", \"downstream_inject_any\": " << (action.downstream_inject_any_ ? "true" : "false")
+        << ", \"downstream_remove_headers\": " << jsonStringList(action.downstream_remove_headers_)
+        << ", \"redo_routing\": " << (action.redo_routing_ ? "true" : "false");
+  }
+  if (action.action_ == "abort" || action.action_ == "dynamic") {
+    out << ", \"use_rpc_response\": " << (action.use_rpc_response_ ? "true" : "false")
+        << ", \"response_code\": " << action.response_code_;
+  }
+  out << "}";
+}
+
+void dumpFilter(Http::InjectFilterConfigProvider& provider, std::stringstream& out) {
+  Http::InjectFilterConfigSharedPtr config = provider.config();
+
+  std::vector<Http::InjectWorkerStateSharedPtr> workers = provider.workerStates()->all();
+  Http::InjectLatencyHistogram::Counts latency{};
+  uint64_t rpc_active = 0;
+  std::string worker_active;
+  std::string worker_limit;
+  for (const Http::InjectWorkerStateSharedPtr& worker : workers) {
+    uint64_t active = worker->rpc_active_;
+    rpc_active += active;
+    worker_active += (worker_active.empty() ? "" : ", ") + std::to_string(active);
+    worker_limit += (worker_limit.empty() ? "" : ", ") + std::to_string(worker->limiter_.limit());
+    worker->rpc_latency_.addTo(latency);
+  }
+
+  std::string name = config->stats_prefix();
+  if (!name.empty() && name.back() == '.') {
+    name.pop_back();
+  }
+  out << "{\"name\": " << jsonString(name) << ", \"cluster\": " << jsonString(config->cluster_name())
+      << ", \"timeout_ms\": " << config->timeout_ms() << ", \"circuit\": ";
+  dumpCircuit(*config, out);
+  out << ", \"rpc_active\": " << rpc_active << ", \"rpc_active_per_worker\": [" << worker_active << "]";
+  if (config->concurrency_limit()) {
+    // 0 for a worker that has not triggered yet
+    out << ", \"concurrency_limit_per_worker\": [" << worker_limit << "]";
+  }
+  out << ", \"rpc_latency_us\": {\"p50\": " << Http::InjectLatencyHistogram::quantile(latency, 0.5)
+      << ", \"p90\": " << Http::InjectLatencyHistogram::quantile(latency, 0.9)
+      << ", \"p99\": " << Http::InjectLatencyHistogram::quantile(latency, 0.99)
+      << ", \"p999\": " << Http::InjectLatencyHistogram::quantile(latency, 0.999) << "}"
+      << ", \"actions\": [";
+  const Http::InjectActionMatcher& matcher = config->action_matcher();
+  bool first = true;
+  for (const Http::InjectAction& action : matcher.actions()) {
+    std::stringstream action_out;
+    dumpAction(matcher, action, action_out);
+    if (action_out.tellp() > 0) {
+      out << (first ? "" : ", ") << action_out.str();
+      first = false;
+    }
+  }
+  out << "]}";
+}
+
+} // namespace
+
+void InjectAdmin::add(Admin& admin, Http::InjectFilterConfigProviderSharedPtr provider) {
+  InjectAdminRegistry& reg = registry();
+  reg.providers_.remove_if([](const std::weak_ptr<Http::InjectFilterConfigProvider>& p) { return p.expired(); });
+  // once per admin: a handler registered stays registered after its
+  // filters go, and serves an empty dump until new ones arrive
+  if (reg.admin_ != &admin) {
+    reg.admin_ = &admin;
+    admin.addHandler("/inject", "print inject filter live state", handler);
+  }
+  reg.providers_.push_back(provider);
+}
+
+Http::Code InjectAdmin::handler(const std::string&, Buffer::Instance& response) {
+  response.add(dump());
+  return Http::Code::OK;
+}
+
+std::string InjectAdmin::dump() {
+  std::stringstream out;
+  out << "{\"filters\": [";
+  bool first = true;
+  for (const std::weak_ptr<Http::InjectFilterConfigProvider>& weak : registry().providers_) {
+    Http::InjectFilterConfigProviderSharedPtr provider = weak.lock();
+    if (!provider) {
+      continue;
+    }
+    out << (first ? "" : ", ");
+    dumpFilter(*provider, out);
+    first = false;
+  }
+  out << "]}\n";
+  return out.str();
+}
+
+} // Server
+} // Envoy
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/http/codes.h"
+#include "envoy/server/admin.h"
+#include "inject.h"
+
+namespace Envoy {
+namespace Server {
+
+/**
+ * The /inject admin handler. Dumps the live state of every inject filter
+ * in the process as JSON: in-flight RPCs per worker, the current timeout
+ * and circuit breaker state of the inject cluster, RPC latency
+ * percentiles and the compiled action table.
+ *
+ * All methods run on the main thread.
+ */
+class InjectAdmin {
+public:
+  // include the filter's provider in the dump, registering the handler
+  // the first time this admin is seen
+  static void add(Admin& admin, Http::InjectFilterConfigProviderSharedPtr provider);
+
+  static Http::Code handler(const std::string& url, Buffer::Instance& response);
+
+  // the JSON served by handler()
+  static std::string dump();
+};
+
+} // Server
+} // Envoy
@@ -0,0 +1,120 @@
+// Checks that requests the inject filter passes over untouched (not
+// triggered or antitriggered) make no heap allocations in decodeHeaders.
+// Allocations are counted through tcmalloc's new hook, so this needs the
+// default tcmalloc build. Regex trigger headers are not covered:
+// std::regex matching allocates. The route lookup every request makes
+// is answered without gmock (see alloc_free_mocks.h), as it would be by
+// the connection manager.
+
+#include <memory>
+#include <string>
+
+#include "alloc_counter.h"
+#include "alloc_free_mocks.h"
+#include "inject_config.h"
+
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/server/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+using testing::NiceMock;
+using testing::Return;
+using testing::_;
+
+namespace Http {
+
+class InjectAllocTest : public testing::Test {
+public:
+  InjectAllocTest() {
+    const std::string filter_config = R"EOF(
+    {
+      "trigger_headers": [{ "name": "x-session"}, { "name": "x-tenant", "value": "gold"}, { "name": "cookie.sessId"}],
+      "antitrigger_headers": [{ "name": "x-inject-skip"}],
+      "include_headers": [":path"],
+      "cluster_name": "sessionCheck",
+      "actions": [
+        {
+          "result": ["ok"],
+          "action": "passthrough"
+        }
+      ]
+    }
+    )EOF";
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+    config_ = Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_);
+    filter_.reset(new InjectFilter(config_));
+    filter_->setDecoderFilterCallbacks(decoder_callbacks_);
+    filter_->setEncoderFilterCallbacks(encoder_callbacks_);
+  }
+
+  // allocations made by decodeHeaders for these headers
+  uint64_t decodeHeadersAllocs(HeaderMap& headers, FilterHeadersStatus expected_status) {
+    uint64_t start = AllocCounter::count();
+    FilterHeadersStatus status = filter_->decodeHeaders(headers, true);
+    uint64_t allocs = AllocCounter::count() - start;
+    EXPECT_EQ(expected_status, status);
+    return allocs;
+  }
+
+  NiceMock<Server::Configuration::MockFactoryContext> fac_ctx_;
+  AllocFreeDecoderFilterCallbacks decoder_callbacks_;
+  NiceMock<MockStreamEncoderFilterCallbacks> encoder_callbacks_;
+  InjectFilterConfigSharedPtr config_;
+  std::unique_ptr<InjectFilter> filter_;
+};
+
+TEST_F(InjectAllocTest, NotTriggeredDoesNotAllocate) {
+  TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/api/v1/orders"}, {":authority", "host"},
+                            {"x-tenant", "silver"}, {"cookie", "_ga=GA1.2.123; sessIdx=1; lang=en"},
+                            {"cookie", "theme=dark"}};
+  EXPECT_EQ(0U, decodeHeadersAllocs(headers, FilterHeadersStatus::Continue));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.not_triggered").value());
+}
+
+TEST_F(InjectAllocTest, EmptyTriggerCookieDoesNotAllocate) {
+  TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}, {"cookie", "sessId=; lang=en"}};
+  EXPECT_EQ(0U, decodeHeadersAllocs(headers, FilterHeadersStatus::Continue));
+}
+
+TEST_F(InjectAllocTest, AntitriggeredDoesNotAllocate) {
+  TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}, {"x-session", "abc"},
+                            {"cookie", "sessId=123"}, {"x-inject-skip", "1"}};
+  EXPECT_EQ(0U, decodeHeadersAllocs(headers, FilterHeadersStatus::Continue));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.antitriggered").value());
+}
+
+TEST_F(InjectAllocTest, InternalRequestDoesNotAllocate) {
+  TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}, {"x-session", "abc"},
+                            {"x-envoy-internal", "true"}};
+  EXPECT_EQ(0U, decodeHeadersAllocs(headers, FilterHeadersStatus::Continue));
+}
+
+// a route whose opaque config is for someone else is looked through
+TEST_F(InjectAllocTest, OtherRouteOpaqueConfigDoesNotAllocate) {
+  decoder_callbacks_.alloc_free_route_->entry_.opaque_ = {{"ratelimit.key", "gold"}, {"tenant", "a"}};
+  TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}, {"x-tenant", "silver"}};
+  EXPECT_EQ(0U, decodeHeadersAllocs(headers, FilterHeadersStatus::Continue));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.not_triggered").value());
+}
+
+TEST_F(InjectAllocTest, RouteDisabledDoesNotAllocate) {
+  decoder_callbacks_.alloc_free_route_->entry_.opaque_ = {{"inject.disabled", "true"}};
+  TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}, {"cookie", "sessId=123"}};
+  EXPECT_EQ(0U, decodeHeadersAllocs(headers, FilterHeadersStatus::Continue));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.route_disabled").value());
+}
+
+// makes sure the hook is counting at all
+TEST_F(InjectAllocTest, TriggeredAllocates) {
+  TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}, {"cookie", "lang=en; sessId=123"}};
+  EXPECT_LT(0U, decodeHeadersAllocs(headers, FilterHeadersStatus::StopIteration));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.triggered").value());
+  filter_->onDestroy();
+}
+
+} // Http
+} // Envoy
@@ -0,0 +1,414 @@
+// Microbenchmarks for the inject filter hot paths. Each benchmark
+// reports ns/op and allocs_per_op (heap allocations per iteration on
+// the benchmark thread).
+//
+// bazel run -c opt //:inject_benchmark
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include "alloc_counter.h"
+#include "alloc_free_mocks.h"
+#include "inject_config.h"
+#include "common/common/thread.h"
+#include "common/http/header_map_impl.h"
+
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/server/mocks.h"
+
+#include "benchmark/benchmark.h"
+
+namespace Envoy {
+namespace Http {
+
+using testing::NiceMock;
+using testing::Return;
+using testing::_;
+
+namespace {
+
+const std::string inject_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "x-session"}, { "name": "cookie.sessId"}],
+    "antitrigger_headers": [{ "name": "x-inject-skip"}],
+    "include_headers": [":path", "user-agent"],
+    "cluster_name": "sessionCheck",
+    "actions": [
+      {
+        "result": ["ok"],
+        "action": "passthrough",
+        "upstream_inject_headers": ["x-user", "authorization"],
+        "upstream_remove_headers": ["cookie.sessId"],
+        "downstream_inject_headers": ["x-session-expires"]
+      },
+      {
+        "result": ["deny"],
+        "action": "abort",
+        "response_code": 403,
+        "response_headers": [{ "key": "www-authenticate", "value": "Bearer" }],
+        "response_body": "session expired"
+      }
+    ]
+  }
+  )EOF";
+
+// state shared by the filter benchmarks; mocks are built once since
+// they cost far more than the filter
+class InjectBenchmarkContext {
+public:
+  InjectBenchmarkContext() {
+    ON_CALL(fac_ctx_.cluster_manager_.async_client_, start(_, _)).WillByDefault(Return(&async_stream_));
+    Json::ObjectSharedPtr json = Json::Factory::loadFromString(inject_config);
+    config_ = Server::Configuration::InjectFilterConfig::createConfig(*json, "bench.", fac_ctx_);
+  }
+
+  std::unique_ptr<InjectFilter> newFilter() {
+    std::unique_ptr<InjectFilter> filter(new InjectFilter(config_));
+    filter->setDecoderFilterCallbacks(decoder_callbacks_);
+    filter->setEncoderFilterCallbacks(encoder_callbacks_);
+    return filter;
+  }
+
+  NiceMock<Server::Configuration::MockFactoryContext> fac_ctx_;
+  NiceMock<MockAsyncClientStream> async_stream_;
+  // route() is on every request's path; see alloc_free_mocks.h
+  AllocFreeDecoderFilterCallbacks decoder_callbacks_;
+  NiceMock<MockStreamEncoderFilterCallbacks> encoder_callbacks_;
+  InjectFilterConfigSharedPtr config_;
+};
+
+InjectBenchmarkContext& context() {
+  static InjectBenchmarkContext* context = new InjectBenchmarkContext();
+  return *context;
+}
+
+// a browser-like request with header_count headers in all
+HeaderMapPtr requestHeaders(int header_count, bool triggered, bool antitriggered) {
+  HeaderMapPtr headers(new HeaderMapImpl());
+  headers->addCopy(Headers::get().Method, "GET");
+  headers->addCopy(Headers::get().Path, "/api/v1/accounts/12345/orders?page=2");
+  headers->addCopy(Headers::get().Host, "shop.example.com");
+  headers->addCopy(Headers::get().Scheme, "https");
+  headers->addCopy(Headers::get().UserAgent,
+                   "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/60.0 Safari/537.36");
+  headers->addCopy(LowerCaseString("cookie"),
+                   std::string("_ga=GA1.2.1234567890.1500000000; ") + (triggered ? "sessId=0123456789abcdef; " : "") +
+                       "lang=en-US; theme=dark");
+  if (antitriggered) {
+    headers->addCopy(LowerCaseString("x-inject-skip"), "1");
+  }
+  for (int i = headers->size(); i < header_count; i++) {
+    headers->addCopy(LowerCaseString("x-custom-header-" + std::to_string(i)), "some-value-" + std::to_string(i));
+  }
+  return headers;
+}
+
+std::string jwt(size_t size) {
+  std::string token = "Bearer eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCJ9.";
+  while (token.size() < size) {
+    token += "eyJzdWIiOiIxMjM0NTY3ODkwIiwibmFtZSI6IkpvaG4gRG9lIiwiaWF0IjoxNTE2MjM5MDIyfQ";
+  }
+  token.resize(size);
+  return token;
+}
+
+std::unique_ptr<inject::InjectResponse> okResponse(size_t jwt_size) {
+  std::unique_ptr<inject::InjectResponse> response(new inject::InjectResponse());
+  response->set_result("ok");
+  inject::Header* user = response->add_upstreamheaders();
+  user->set_key("x-user");
+  user->set_value("user-12345");
+  inject::Header* token = response->add_upstreamheaders();
+  token->set_key("authorization");
+  token->set_value(jwt(jwt_size));
+  inject::Header* expires = response->add_downstreamheaders();
+  expires->set_key("x-session-expires");
+  expires->set_value("1500003600");
+  return response;
+}
+
+std::unique_ptr<inject::InjectResponse> denyResponse() {
+  std::unique_ptr<inject::InjectResponse> response(new inject::InjectResponse());
+  response->set_result("deny");
+  return response;
+}
+
+void setAllocsPerOp(benchmark::State& state, uint64_t allocs) {
+  state.counters["allocs_per_op"] = state.iterations() ? static_cast<double>(allocs) / state.iterations() : 0;
+}
+
+void decodeHeaders(benchmark::State& state, bool triggered, bool antitriggered) {
+  InjectBenchmarkContext& ctx = context();
+  HeaderMapPtr headers = requestHeaders(state.range(0), triggered, antitriggered);
+  uint64_t allocs = AllocCounter::count();
+  while (state.KeepRunning()) {
+    std::unique_ptr<InjectFilter> filter = ctx.newFilter();
+    benchmark::DoNotOptimize(filter->decodeHeaders(*headers, true));
+    filter->onDestroy();
+  }
+  setAllocsPerOp(state, AllocCounter::count() - allocs);
+}
+
+} // namespace
+
+static void BM_DecodeHeadersNotTriggered(benchmark::State& state) { decodeHeaders(state, false, false); }
+BENCHMARK(BM_DecodeHeadersNotTriggered)->Arg(8)->Arg(16)->Arg(32)->Arg(64);
+
+static void BM_DecodeHeadersAntitriggered(benchmark::State& state) { decodeHeaders(state, true, true); }
+BENCHMARK(BM_DecodeHeadersAntitriggered)->Arg(8)->Arg(16)->Arg(32)->Arg(64);
+
+// builds and sends the inject request; the RPC is cancelled by onDestroy
+static void BM_DecodeHeadersTriggered(benchmark::State& state) { decodeHeaders(state, true, false); }
+BENCHMARK(BM_DecodeHeadersTriggered)->Arg(8)->Arg(16)->Arg(32)->Arg(64);
+
+static void matchHeader(benchmark::State& state, const std::string& header_json) {
+  Json::ObjectSharedPtr json = Json::Factory::loadFromString(header_json);
+  InjectHeaderData header_data(*json);
+  HeaderMapPtr headers = requestHeaders(16, true, false);
+  headers->addCopy(LowerCaseString("x-session"), "0123456789abcdef0123456789abcdef");
+  uint64_t allocs = AllocCounter::count();
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(InjectFilter::matchHeader(*headers, header_data));
+  }
+  setAllocsPerOp(state, AllocCounter::count() - allocs);
+}
+
+static void BM_MatchHeaderExact(benchmark::State& state) {
+  matchHeader(state, R"EOF({"name": "x-session", "value": "0123456789abcdef0123456789abcdef"})EOF");
+}
+BENCHMARK(BM_MatchHeaderExact);
+
+static void BM_MatchHeaderRegex(benchmark::State& state) {
+  matchHeader(state, R"EOF({"name": "x-session", "value": "[0-9a-f]{32}", "regex": true})EOF");
+}
+BENCHMARK(BM_MatchHeaderRegex);
+
+static const std::string bench_cookie_value =
+    "_ga=GA1.2.1234567890.1500000000; sessId=0123456789abcdef; lang=en-US; theme=dark";
+
+static void BM_RemoveNamedCookieString(benchmark::State& state) {
+  uint64_t allocs = 0;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    std::string value = bench_cookie_value;
+    state.ResumeTiming();
+    uint64_t start = AllocCounter::count();
+    InjectFilter::removeNamedCookie("sessId", value);
+    allocs += AllocCounter::count() - start;
+  }
+  setAllocsPerOp(state, allocs);
+}
+BENCHMARK(BM_RemoveNamedCookieString);
+
+static void BM_RemoveNamedCookieHeaderMap(benchmark::State& state) {
+  uint64_t allocs = 0;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    HeaderMapPtr headers = requestHeaders(16, true, false);
+    state.ResumeTiming();
+    uint64_t start = AllocCounter::count();
+    InjectFilter::removeNamedCookie("sessId", *headers);
+    allocs += AllocCounter::count() - start;
+  }
+  setAllocsPerOp(state, allocs);
+}
+BENCHMARK(BM_RemoveNamedCookieHeaderMap);
+
+// onSuccess with a passthrough result: header injection into the
+// request, cookie removal and continuing decoding. Arg is the size of
+// the injected authorization token.
+static void BM_PassThroughAction(benchmark::State& state) {
+  InjectBenchmarkContext& ctx = context();
+  uint64_t allocs = 0;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    HeaderMapPtr headers = requestHeaders(16, true, false);
+    std::unique_ptr<InjectFilter> filter = ctx.newFilter();
+    filter->decodeHeaders(*headers, true);
+    std::unique_ptr<inject::InjectResponse> response = okResponse(state.range(0));
+    state.ResumeTiming();
+    uint64_t start = AllocCounter::count();
+    filter->onSuccess(std::move(response));
+    allocs += AllocCounter::count() - start;
+    state.PauseTiming();
+    filter->onDestroy();
+    filter.reset();
+    headers.reset();
+    state.ResumeTiming();
+  }
+  setAllocsPerOp(state, allocs);
+}
+BENCHMARK(BM_PassThroughAction)->Arg(64)->Arg(2048)->Arg(4096);
+
+// response path after a passthrough: downstream header injection
+static void BM_EncodeHeaders(benchmark::State& state) {
+  InjectBenchmarkContext& ctx = context();
+  uint64_t allocs = 0;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    HeaderMapPtr headers = requestHeaders(16, true, false);
+    std::unique_ptr<InjectFilter> filter = ctx.newFilter();
+    filter->decodeHeaders(*headers, true);
+    filter->onSuccess(okResponse(64));
+    HeaderMapPtr response_headers(new HeaderMapImpl());
+    response_headers->addCopy(Headers::get().Status, "200");
+    response_headers->addCopy(Headers::get().ContentType, "application/json");
+    response_headers->addCopy(Headers::get().ContentLength, "1234");
+    state.ResumeTiming();
+    uint64_t start = AllocCounter::count();
+    benchmark::DoNotOptimize(filter->encodeHeaders(*response_headers, false));
+    allocs += AllocCounter::count() - start;
+    state.PauseTiming();
+    filter->onDestroy();
+    filter.reset();
+    response_headers.reset();
+    headers.reset();
+    state.ResumeTiming();
+  }
+  setAllocsPerOp(state, allocs);
+}
+BENCHMARK(BM_EncodeHeaders);
+
+// onSuccess with an abort result: building and sending the local reply
+static void BM_AbortAction(benchmark::State& state) {
+  InjectBenchmarkContext& ctx = context();
+  uint64_t allocs = 0;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    HeaderMapPtr headers = requestHeaders(16, true, false);
+    std::unique_ptr<InjectFilter> filter = ctx.newFilter();
+    filter->decodeHeaders(*headers, true);
+    std::unique_ptr<inject::InjectResponse> response = denyResponse();
+    state.ResumeTiming();
+    uint64_t start = AllocCounter::count();
+    filter->onSuccess(std::move(response));
+    allocs += AllocCounter::count() - start;
+    state.PauseTiming();
+    filter->onDestroy();
+    filter.reset();
+    headers.reset();
+    state.ResumeTiming();
+  }
+  setAllocsPerOp(state, allocs);
+}
+BENCHMARK(BM_AbortAction);
+
+// Startup: build the configs of state.range(0) inject filters, as a
+// server with that many across its listeners and routes does at load.
+// The JSON form is checked against the JSON schema then read field by
+// field; the typed form is the same fields as an InjectConfig proto.
+// Parsing the config file itself is common to both and not timed.
+static std::string generatedConfig(int i) {
+  return fmt::format(R"EOF(
+  {{
+    "trigger_headers": [{{ "name": "x-session-{0}"}}, {{ "name": "cookie.sess{0}"}}],
+    "antitrigger_headers": [{{ "name": "x-inject-skip"}}],
+    "include_headers": [":path", "user-agent"],
+    "cluster_name": "sessionCheck",
+    "timeout_ms": {1},
+    "stat_prefix": "f{0}",
+    "actions": [
+      {{
+        "result": ["ok"],
+        "upstream_inject_headers": ["x-user", "authorization"],
+        "upstream_remove_headers": ["cookie.sess{0}"],
+        "downstream_inject_headers": ["x-session-expires"]
+      }},
+      {{
+        "result": ["deny"],
+        "action": "abort",
+        "response_code": 403,
+        "response_body": "session expired"
+      }}
+    ]
+  }}
+  )EOF", i, 50 + i % 100);
+}
+
+static void createConfigs(benchmark::State& state, bool typed) {
+  InjectBenchmarkContext& ctx = context();
+  std::vector<Json::ObjectSharedPtr> configs;
+  for (int i = 0; i < state.range(0); i++) {
+    std::string config = generatedConfig(i);
+    configs.push_back(Json::Factory::loadFromString(typed ? "{\"typed_config\": " + config + "}" : config));
+  }
+  while (state.KeepRunning()) {
+    for (const Json::ObjectSharedPtr& config : configs) {
+      benchmark::DoNotOptimize(Server::Configuration::InjectFilterConfig::createConfig(*config, "bench.", ctx.fac_ctx_));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_CreateConfigJson(benchmark::State& state) { createConfigs(state, false); }
+BENCHMARK(BM_CreateConfigJson)->Arg(10)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+static void BM_CreateConfigTyped(benchmark::State& state) { createConfigs(state, true); }
+BENCHMARK(BM_CreateConfigTyped)->Arg(10)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+// Worker scaling: each benchmark thread stands in for an Envoy worker
+// (run at --benchmark_filter=WorkerScaling to see 1, 2, 4 ... N) and
+// creates a filter per request and runs decodeHeaders on a request that
+// does not trigger. Each thread has its own stream callbacks, as each
+// worker has its own streams. per_core is requests/s per thread and
+// efficiency is per_core relative to the single thread run, so 1 means
+// perfect scaling. Filter stats counters are process-wide atomics in this Envoy
+// and are part of what is measured.
+static int maxWorkers() { return std::max(1U, std::thread::hardware_concurrency()); }
+
+static void workerScaling(benchmark::State& state, bool per_worker_config, double& single_thread_rate) {
+  InjectBenchmarkContext& ctx = context();
+  // what the provider installs on each worker
+  ThreadLocalInjectConfig worker_config(ctx.config_, nullptr);
+  const InjectFilterConfigSharedPtr& config = per_worker_config ? worker_config.config_ : ctx.config_;
+  HeaderMapPtr headers = requestHeaders(16, false, false);
+  AllocFreeDecoderFilterCallbacks decoder_callbacks;
+
+  MonotonicTime start = std::chrono::steady_clock::now();
+  while (state.KeepRunning()) {
+    InjectFilter filter(config);
+    filter.setDecoderFilterCallbacks(decoder_callbacks);
+    benchmark::DoNotOptimize(filter.decodeHeaders(*headers, true));
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double rate = state.iterations() / seconds;
+  if (state.threads == 1) {
+    single_thread_rate = rate;
+  }
+  state.counters["per_core"] = benchmark::Counter(rate, benchmark::Counter::kAvgThreads);
+  state.counters["efficiency"] =
+      benchmark::Counter(single_thread_rate > 0 ? rate / single_thread_rate : 0, benchmark::Counter::kAvgThreads);
+}
+
+// filters share one reference count for the config across workers
+static void BM_WorkerScalingSharedConfig(benchmark::State& state) {
+  static double single_thread_rate;
+  workerScaling(state, false, single_thread_rate);
+}
+BENCHMARK(BM_WorkerScalingSharedConfig)->ThreadRange(1, maxWorkers())->UseRealTime();
+
+// filters take their config from the worker's ThreadLocalInjectConfig,
+// as InjectFilterConfigProvider hands it out
+static void BM_WorkerScalingPerWorkerConfig(benchmark::State& state) {
+  static double single_thread_rate;
+  workerScaling(state, true, single_thread_rate);
+}
+BENCHMARK(BM_WorkerScalingPerWorkerConfig)->ThreadRange(1, maxWorkers())->UseRealTime();
+
+} // Http
+} // Envoy
+
+int main(int argc, char** argv) {
+  // the filter logs every trigger at info
+  Envoy::Thread::MutexBasicLockable lock;
+  Envoy::Logger::Registry::initialize(spdlog::level::err, lock);
+
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,11 @@
+#!/bin/bash
+#
+
+set -e
+
+# Just test that every benchmark sets up and runs: a config the filter
+# rejects or a crash in a benchmark body aborts the binary. One short
+# run each, the timings are not looked at.
+"$1" --benchmark_min_time=0.001
+
+echo "PASS"
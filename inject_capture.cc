@@ -0,0 +1,31 @@
+#include "inject_capture.h"
+
+#include <string>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+
+namespace Envoy {
+namespace Http {
+
+bool InjectCapture::write(const inject::InjectCaptureRecord& record) {
+  const uint32_t size = record.ByteSize();
+  const uint64_t framed_size = google::protobuf::io::CodedOutputStream::VarintSize32(size) + size;
+  if (bytes_written_->fetch_add(framed_size) + framed_size > max_bytes_) {
+    return false;
+  }
+
+  std::string framed;
+  framed.reserve(framed_size);
+  {
+    google::protobuf::io::StringOutputStream stream(&framed);
+    google::protobuf::io::CodedOutputStream coded(&stream);
+    coded.WriteVarint32(size);
+    record.SerializeWithCachedSizes(&coded);
+  }
+  file_->write(framed);
+  return true;
+}
+
+} // Http
+} // Envoy
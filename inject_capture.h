@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "envoy/filesystem/filesystem.h"
+#include "envoy/runtime/runtime.h"
+#include "inject.pb.h"
+
+namespace Envoy {
+namespace Http {
+
+/**
+ * Writes sampled inject RPCs to a capture file for offline replay (see
+ * inject_replay). Records are InjectCaptureRecord protos, each preceded
+ * by its varint encoded length. Writes go through the access log file
+ * machinery, so they only append to a buffer that a flush thread drains;
+ * the file stops growing once max_bytes have been written by this
+ * process, across config reloads (see continueFrom()).
+ *
+ * Shared by all workers.
+ */
+class InjectCapture {
+public:
+  InjectCapture(Filesystem::FileSharedPtr file, Runtime::RandomGenerator& random, double sample_percent,
+                uint64_t max_bytes)
+    : file_(file), random_(random), sample_per_million_(sample_percent * 10000), max_bytes_(max_bytes) {}
+
+  // whether to capture the next RPC
+  bool sample() { return random_.random() % 1000000 < sample_per_million_; }
+
+  // false if the record was dropped because the file is full
+  bool write(const inject::InjectCaptureRecord& record);
+
+  // main thread, before this capture is in use: if previous (from the
+  // config this one replaces) writes the same file, count bytes written
+  // together with it
+  void continueFrom(const InjectCapture& previous) {
+    if (previous.file_ == file_) {
+      bytes_written_ = previous.bytes_written_;
+    }
+  }
+
+private:
+  Filesystem::FileSharedPtr file_;
+  Runtime::RandomGenerator& random_;
+  const uint64_t sample_per_million_;
+  const uint64_t max_bytes_;
+  std::shared_ptr<std::atomic<uint64_t>> bytes_written_{std::make_shared<std::atomic<uint64_t>>(0)};
+};
+
+typedef std::shared_ptr<InjectCapture> InjectCaptureSharedPtr;
+
+} // Http
+} // Envoy
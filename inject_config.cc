@@ -2,11 +2,14 @@
 
 #include "envoy/registry/registry.h"
 #include "envoy/common/exception.h"
+#include "envoy/event/dispatcher.h"
 #include "common/json/config_schemas.h"
 #include "common/json/json_validator.h"
 #include "inject.h"
+#include "inject_admin.h"
 #include <iostream>
 
+
 namespace Envoy {
 namespace Server {
 namespace Configuration {
@@ -46,6 +49,12 @@ const std::string INJECT_SCHEMA(R"EOF(
         "type" : "boolean",
         "description": "Send all headers and pseudo headers with the gRPC inject request. if true, include_headers is ignored. Defaults to false."
       },
+      "route_headers" : {
+        "type" : "array",
+        "uniqueItems" : true,
+        "items" : {"type" : "string"},
+        "description": "request headers the route table matches on. An action with redo_routing only recomputes the route when it changes one of these. If empty, any change does."
+      },
       "params" : {
         "type" : "object",
         "additionalProperties" : true,
@@ -60,6 +69,118 @@ const std::string INJECT_SCHEMA(R"EOF(
         "minimum": 1,
         "description": "milliseconds to wait for gRPC response before taking configurable error handling action. Defaults to 120."
       },
+      "max_buffer_bytes": {
+        "type" : "integer",
+        "minimum": 0,
+        "description": "most request body bytes to buffer per stream while waiting for the inject response. 0, the default, is unbounded."
+      },
+      "buffer_overflow_action": {
+        "type" : "string",
+        "enum" : ["pause", "abort", "error_action"],
+        "description": "when max_buffer_bytes is exceeded: pause downstream reads (default), abort with 413, or stop waiting and apply the local.error action."
+      },
+      "speculative_connect": {
+        "type" : "boolean",
+        "description": "start connecting to the route's upstream cluster while the inject RPC is outstanding if the cluster has no open or opening connection. Defaults to false."
+      },
+      "stat_prefix": {
+        "type" : "string",
+        "description": "distinguishes the stats of this inject filter from others in the same filter chain."
+      },
+      "capture": {
+        "type" : "object",
+        "properties" : {
+          "path" : {
+            "type" : "string",
+            "description": "file inject RPCs are appended to, as length-delimited InjectCaptureRecord protos."
+          },
+          "sample_percent" : {
+            "type" : "number",
+            "minimum" : 0,
+            "maximum" : 100,
+            "description": "percentage of inject RPCs captured. Defaults to 100."
+          },
+          "max_bytes" : {
+            "type" : "integer",
+            "minimum" : 1,
+            "description": "capturing stops once this much has been written. Defaults to 100MB."
+          }
+        },
+        "required" : ["path"],
+        "additionalProperties" : false
+      },
+      "connection_memo": {
+        "type" : "object",
+        "properties" : {
+          "ttl_ms" : {
+            "type" : "integer",
+            "minimum" : 1,
+            "description": "how long an inject response is reused for later requests on the same downstream connection with the same trigger values."
+          },
+          "max_entries" : {
+            "type" : "integer",
+            "minimum" : 1,
+            "description": "responses remembered per worker. Defaults to 10000."
+          }
+        },
+        "required" : ["ttl_ms"],
+        "additionalProperties" : false
+      },
+      "shed": {
+        "type" : "object",
+        "properties" : {
+          "runtime_key" : {
+            "type" : "string",
+            "description": "runtime key giving the percentage of triggered requests that send the inject RPC. Defaults to inject.send_percent, or inject.<stat_prefix>.send_percent with a stat_prefix."
+          },
+          "default_send_percent" : {
+            "type" : "integer",
+            "minimum" : 0,
+            "maximum" : 100,
+            "description": "percentage sent while the runtime key is unset. Defaults to 100."
+          },
+          "action" : {
+            "type" : "string",
+            "enum" : ["passthrough", "error"],
+            "description": "what shed requests do: pass through without injection (default) or take the local.error action."
+          }
+        },
+        "additionalProperties" : false
+      },
+      "concurrency_limit": {
+        "type" : "object",
+        "properties" : {
+          "initial_limit" : { "type" : "integer", "minimum" : 1, "description": "outstanding RPCs allowed per worker at first. Defaults to 20." },
+          "min_limit" : { "type" : "integer", "minimum" : 1, "description": "Defaults to 1." },
+          "max_limit" : { "type" : "integer", "minimum" : 1, "description": "Defaults to 1000." },
+          "sample_window_ms" : { "type" : "integer", "minimum" : 1, "description": "how often the limit is adjusted from the RPC latency measured meanwhile. Defaults to 250." },
+          "baseline_windows" : { "type" : "integer", "minimum" : 1, "description": "the baseline latency is the lowest window mean of this many windows. Defaults to 20." },
+          "tolerance" : { "type" : "number", "minimum" : 1, "description": "latency up to this multiple of the baseline does not shrink the limit. Defaults to 1.5." },
+          "over_limit_action" : {
+            "type" : "string",
+            "enum" : ["error", "passthrough"],
+            "description": "what requests over the limit do: take the local.error action (default) or pass through without injection."
+          }
+        },
+        "additionalProperties" : false
+      },
+      "route_configs": {
+        "type" : "object",
+        "additionalProperties" : {
+          "type" : "object",
+          "additionalProperties" : false,
+          "properties" : {
+            "cluster_name" : { "type" : "string" },
+            "timeout_ms" : { "type" : "integer", "minimum" : 1 },
+            "actions" : { "$ref" : "#/properties/actions" }
+          }
+        },
+        "description": "named variants of this config with their own cluster_name, timeout_ms or actions, chosen by a route's opaque_config."
+      },
+      "reload_file": {
+        "type" : "string",
+        "description": "path of a file holding this filter's config. When a new version is moved into place the filter is reconfigured without a drain."
+      },
       "actions": {
         "type" : "array",
         "minimum": 1,
@@ -119,13 +240,18 @@ const std::string INJECT_SCHEMA(R"EOF(
               "items": {
                 "type": "object",
                 "additionalProperties": false,
+                "required" : ["key"],
                 "properties" : {
                   "key" : { "type": "string" },
                   "value" : { "type": "string" }
                 }
               }
             },
-            "response_body" : { "type": "string" }
+            "response_body" : { "type": "string" },
+            "redo_routing" : {
+              "type" : "boolean",
+              "description": "recompute the route after this action changes upstream headers named in route_headers. Defaults to false."
+            }
           }
         }
       }
@@ -133,6 +259,164 @@ const std::string INJECT_SCHEMA(R"EOF(
   }
 )EOF"); // "
 
+namespace {
+
+// verify that target cluster exists
+void checkCluster(FactoryContext& fac_ctx, const std::string& cluster_name) {
+  if (!fac_ctx.clusterManager().get(cluster_name)) {
+    throw EnvoyException("Inject filter requires 'cluster_name' cluster for gRPC inject request to be configured statically in the config file. No such cluster: " + cluster_name);
+  }
+}
+
+std::vector<Http::LowerCaseString> lowerCaseStrings(const google::protobuf::RepeatedPtrField<std::string>& names) {
+  std::vector<Http::LowerCaseString> lc;
+  lc.reserve(names.size());
+  for (const std::string& name : names) {
+    lc.push_back(Http::LowerCaseString(name));
+  }
+  return lc;
+}
+
+std::string shedRuntimeKey(const std::string& filter_stat_prefix) {
+  return filter_stat_prefix.empty() ? "inject.send_percent" : "inject." + filter_stat_prefix + ".send_percent";
+}
+
+Http::InjectConcurrencyLimitConfigConstSharedPtr concurrencyLimit(uint64_t initial_limit, uint64_t min_limit,
+                                                                  uint64_t max_limit, uint64_t sample_window_ms,
+                                                                  uint64_t baseline_windows, double tolerance,
+                                                                  bool passthrough) {
+  if (min_limit > max_limit || initial_limit < min_limit || initial_limit > max_limit) {
+    throw EnvoyException("Inject filter concurrency_limit needs min_limit <= initial_limit <= max_limit");
+  }
+  return Http::InjectConcurrencyLimitConfigConstSharedPtr(new Http::InjectConcurrencyLimitConfig{
+      static_cast<uint32_t>(initial_limit), static_cast<uint32_t>(min_limit), static_cast<uint32_t>(max_limit),
+      std::chrono::milliseconds(sample_window_ms), static_cast<uint32_t>(baseline_windows), tolerance,
+      passthrough ? Http::InjectConcurrencyLimitConfig::OverLimitAction::Passthrough
+                  : Http::InjectConcurrencyLimitConfig::OverLimitAction::Error});
+}
+
+// a route config, taking what it does not set from base
+Http::InjectFilterConfigSharedPtr routeConfig(Http::InjectFilterConfig& base, const std::string& cluster_name,
+                                              int64_t timeout_ms, Http::InjectActionMatcherPtr&& action_matcher,
+                                              FactoryContext& fac_ctx) {
+  if (!cluster_name.empty()) {
+    checkCluster(fac_ctx, cluster_name);
+  }
+  return std::make_shared<Http::InjectFilterConfig>(base, cluster_name.empty() ? base.cluster_name() : cluster_name,
+                                                    timeout_ms > 0 ? timeout_ms : base.timeout_ms(),
+                                                    std::move(action_matcher), fac_ctx.scope());
+}
+
+Http::InjectActionMatcherPtr actionMatcher(const google::protobuf::RepeatedPtrField<inject::InjectConfig::Action>& actions);
+
+void jsonToMessage(const Json::Object& json, google::protobuf::Message& message);
+
+// one field of message from json[name], by the proto3 JSON mapping
+// for the field types InjectConfig uses
+void jsonToField(const Json::Object& json, const std::string& name, const google::protobuf::FieldDescriptor& field,
+                 google::protobuf::Message& message) {
+  using google::protobuf::FieldDescriptor;
+  const google::protobuf::Reflection& reflection = *message.GetReflection();
+  if (field.is_map()) {
+    const google::protobuf::Descriptor& entry_type = *field.message_type();
+    const FieldDescriptor& value_field = *entry_type.FindFieldByName("value");
+    json.getObject(name)->iterate([&](const std::string& key, const Json::Object& value) {
+      google::protobuf::Message& entry = *reflection.AddMessage(&message, &field);
+      entry.GetReflection()->SetString(&entry, entry_type.FindFieldByName("key"), key);
+      if (value_field.cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE) {
+        jsonToMessage(value, *entry.GetReflection()->MutableMessage(&entry, &value_field));
+      } else {
+        entry.GetReflection()->SetString(&entry, &value_field, value.asString());
+      }
+      return true;
+    });
+    return;
+  }
+  if (field.is_repeated()) {
+    if (field.cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE) {
+      for (const Json::ObjectSharedPtr& element : json.getObjectArray(name)) {
+        jsonToMessage(*element, *reflection.AddMessage(&message, &field));
+      }
+    } else {
+      for (const std::string& element : json.getStringArray(name)) {
+        reflection.AddString(&message, &field, element);
+      }
+    }
+    return;
+  }
+  switch (field.cpp_type()) {
+  case FieldDescriptor::CPPTYPE_STRING:
+    reflection.SetString(&message, &field, json.getString(name));
+    break;
+  case FieldDescriptor::CPPTYPE_BOOL:
+    reflection.SetBool(&message, &field, json.getBoolean(name));
+    break;
+  case FieldDescriptor::CPPTYPE_INT32:
+    reflection.SetInt32(&message, &field, json.getInteger(name));
+    break;
+  case FieldDescriptor::CPPTYPE_INT64:
+    reflection.SetInt64(&message, &field, json.getInteger(name));
+    break;
+  case FieldDescriptor::CPPTYPE_UINT32:
+  case FieldDescriptor::CPPTYPE_UINT64: {
+    const int64_t value = json.getInteger(name);
+    if (value < 0) {
+      throw EnvoyException(name + " must not be negative");
+    }
+    if (field.cpp_type() == FieldDescriptor::CPPTYPE_UINT32) {
+      reflection.SetUInt32(&message, &field, value);
+    } else {
+      reflection.SetUInt64(&message, &field, value);
+    }
+    break;
+  }
+  case FieldDescriptor::CPPTYPE_DOUBLE: {
+    // a whole number is written without a fraction
+    double value;
+    try {
+      value = json.getDouble(name);
+    } catch (const Json::Exception&) {
+      value = json.getInteger(name);
+    }
+    reflection.SetDouble(&message, &field, value);
+    break;
+  }
+  case FieldDescriptor::CPPTYPE_ENUM: {
+    const std::string value_name = json.getString(name);
+    const google::protobuf::EnumValueDescriptor* value = field.enum_type()->FindValueByName(value_name);
+    if (!value) {
+      throw EnvoyException(name + " has no value " + value_name);
+    }
+    reflection.SetEnum(&message, &field, value);
+    break;
+  }
+  case FieldDescriptor::CPPTYPE_MESSAGE:
+    jsonToMessage(*json.getObject(name), *reflection.MutableMessage(&message, &field));
+    break;
+  default:
+    throw EnvoyException(name + " has an unsupported type");
+  }
+}
+
+// fill message from the already parsed json, accepting field names as
+// written in the proto or in lowerCamelCase like JsonStringToMessage
+void jsonToMessage(const Json::Object& json, google::protobuf::Message& message) {
+  const google::protobuf::Descriptor& type = *message.GetDescriptor();
+  json.iterate([&](const std::string& name, const Json::Object&) {
+    const google::protobuf::FieldDescriptor* field = type.FindFieldByName(name);
+    if (!field) {
+      field = type.FindFieldByCamelcaseName(name);
+    }
+    if (!field) {
+      throw EnvoyException("unknown field " + name + " in " + type.name());
+    }
+    jsonToField(json, name, *field, message);
+    return true;
+  });
+}
+
+} // namespace
+
 /**
  * Register Inject filter so http filter entries with name "inject"
  * and type "decoder" in the config will create this filter
@@ -144,29 +428,50 @@ HttpFilterFactoryCb InjectFilterConfig::createFilterFactory(const Json::Object&
                                                             const std::string& statsd_prefix,
                                                             FactoryContext& fac_ctx) {
 
-  Http::InjectFilterConfigSharedPtr config = createConfig(json_config, statsd_prefix, fac_ctx);
-  return [config](Http::FilterChainFactoryCallbacks& callbacks) -> void {
+  Http::InjectFilterConfigSharedPtr config;
+  std::string reload_file;
+  if (json_config.hasObject("typed_config")) {
+    inject::InjectConfig proto_config = typedConfig(json_config);
+    config = createConfig(proto_config, statsd_prefix, fac_ctx);
+    reload_file = proto_config.reload_file();
+  } else {
+    config = createConfig(json_config, statsd_prefix, fac_ctx);
+    reload_file = json_config.getString("reload_file", "");
+  }
+  Http::InjectFilterConfigProviderSharedPtr provider(new Http::InjectFilterConfigProvider(fac_ctx.threadLocal(), config));
+
+  Server::InjectAdmin::add(fac_ctx.admin(), provider);
+
+  InjectConfigReloaderSharedPtr reloader;
+  if (!reload_file.empty()) {
+    reloader.reset(new InjectConfigReloader(reload_file, statsd_prefix, provider, fac_ctx));
+  }
+
+  // reloader rides along in the callback so it lives as long as the filter chain
+  return [provider, reloader](Http::FilterChainFactoryCallbacks& callbacks) -> void {
     callbacks.addStreamFilter(
-        Http::StreamFilterSharedPtr{new Http::InjectFilter(config)});
+        Http::StreamFilterSharedPtr{new Http::InjectFilter(provider->config(), provider->workerState())});
   };
 
 }
 
 Http::InjectFilterConfigSharedPtr InjectFilterConfig::createConfig(const Json::Object& json_config,
-                                                                   const std::string&,
+                                                                   const std::string& stat_prefix,
                                                                    FactoryContext& fac_ctx) {
-
+  if (json_config.hasObject("typed_config")) {
+    return createConfig(typedConfig(json_config), stat_prefix, fac_ctx);
+  }
 
   // CLEANUP - see envoy/source/common/router/config_utility.h
   json_config.validateSchema(INJECT_SCHEMA);
 
-  std::vector<Router::ConfigUtility::HeaderData> trigger_headers;
+  std::vector<Http::InjectHeaderData> trigger_headers;
   std::vector<std::string> trigger_cookie_names;
   if (json_config.hasObject("trigger_headers") ) {
     std::vector<Json::ObjectSharedPtr> thdrs = json_config.getObjectArray("trigger_headers");
     trigger_headers.reserve(thdrs.size());
     for (Json::ObjectSharedPtr element : thdrs) {
-      Router::ConfigUtility::HeaderData hd(*element);
+      Http::InjectHeaderData hd(*element);
       if (hd.name_.get().find("cookie.") == 0) {
         trigger_cookie_names.push_back(element->getString("name").substr(7));
         continue;
@@ -175,12 +480,12 @@ Http::InjectFilterConfigSharedPtr InjectFilterConfig::createConfig(const Json::O
     }
   }
 
-  std::vector<Router::ConfigUtility::HeaderData> antitrigger_headers;
+  std::vector<Http::InjectHeaderData> antitrigger_headers;
   if (json_config.hasObject("antitrigger_headers") ) {
     std::vector<Json::ObjectSharedPtr> antithdrs = json_config.getObjectArray("antitrigger_headers");
     antitrigger_headers.reserve(antithdrs.size());
     for (Json::ObjectSharedPtr element : antithdrs) {
-      Router::ConfigUtility::HeaderData hd(*element);
+      Http::InjectHeaderData hd(*element);
       antitrigger_headers.push_back(hd);
     }
   }
@@ -195,6 +500,13 @@ Http::InjectFilterConfigSharedPtr InjectFilterConfig::createConfig(const Json::O
     }
   }
 
+  std::vector<Http::LowerCaseString> route_hdrs_lc;
+  if (json_config.hasObject("route_headers") ) {
+    for (const std::string& element : json_config.getStringArray("route_headers")) {
+      route_hdrs_lc.push_back(Http::LowerCaseString(element));
+    }
+  }
+
   std::map<std::string,std::string> params;
   if (json_config.hasObject("params") ) {
     Json::ObjectSharedPtr p = json_config.getObject("params");
@@ -204,10 +516,243 @@ Http::InjectFilterConfigSharedPtr InjectFilterConfig::createConfig(const Json::O
       });
   }
 
-  Http::InjectActionMatcher* action_matcher;
+  // owned by the config so it is freed along with the snapshot it belongs to
+  Http::InjectActionMatcherPtr action_matcher = createActionMatcher(json_config);
+
+  const std::string& cluster_name = json_config.getString("cluster_name");
+  const int64_t timeout_ms = json_config.getInteger("timeout_ms", 120);
+  const bool always_triggered = json_config.getBoolean("always_triggered", false);
+  const bool include_all_headers = json_config.getBoolean("include_all_headers", false);
+  const bool speculative_connect = json_config.getBoolean("speculative_connect", false);
+  const uint64_t max_buffer_bytes = json_config.getInteger("max_buffer_bytes", 0);
+  const std::string overflow = json_config.getString("buffer_overflow_action", "pause");
+  Http::InjectFilterConfig::BufferOverflowAction buffer_overflow_action = Http::InjectFilterConfig::BufferOverflowAction::Pause;
+  if (overflow == "abort") {
+    buffer_overflow_action = Http::InjectFilterConfig::BufferOverflowAction::Abort;
+  } else if (overflow == "error_action") {
+    buffer_overflow_action = Http::InjectFilterConfig::BufferOverflowAction::ErrorAction;
+  }
+
+  bool always_triggered_not_specified  = json_config.getBoolean("always_triggered", true) && !json_config.getBoolean("always_triggered", false);
+  bool disabled = !always_triggered_not_specified && !always_triggered  && (trigger_headers.size() == 0) && (trigger_cookie_names.size() == 0);
+
+  if ((trigger_headers.size() == 0) && (trigger_cookie_names.size() == 0) && !disabled) {
+    throw EnvoyException("Inject filter requires a non-empty trigger_headers list or always_triggered to be explicitly set.");
+  }
+
+  // no need to verify that any header injection could happen - inject could just be mirroring requests for review
+
+  checkCluster(fac_ctx, cluster_name);
+  Http::InjectCaptureSharedPtr capture;
+  if (json_config.hasObject("capture")) {
+    Json::ObjectSharedPtr capture_config = json_config.getObject("capture");
+    capture.reset(new Http::InjectCapture(fac_ctx.accessLogManager().createAccessLog(capture_config->getString("path")),
+                                          fac_ctx.random(), capture_config->getDouble("sample_percent", 100),
+                                          capture_config->getInteger("max_bytes", 100 * 1024 * 1024)));
+  }
+
+  std::chrono::milliseconds memo_ttl(0);
+  uint64_t memo_max_entries = 0;
+  if (json_config.hasObject("connection_memo")) {
+    Json::ObjectSharedPtr memo_config = json_config.getObject("connection_memo");
+    memo_ttl = std::chrono::milliseconds(memo_config->getInteger("ttl_ms"));
+    memo_max_entries = memo_config->getInteger("max_entries", 10000);
+  }
+
+  std::string stats_prefix = stat_prefix + "inject.";
+  if (json_config.hasObject("stat_prefix")) {
+    stats_prefix += json_config.getString("stat_prefix") + ".";
+  }
+
+  // nice to have: ensure no dups in trig vs include hdrs
+  Http::InjectFilterConfigSharedPtr config(new Http::InjectFilterConfig(trigger_headers, trigger_cookie_names, antitrigger_headers,
+                                                                        always_triggered, inc_hdrs_lc, include_all_headers, route_hdrs_lc, params,
+                                                                        fac_ctx.clusterManager(), cluster_name, timeout_ms,
+                                                                        max_buffer_bytes, buffer_overflow_action, speculative_connect, capture,
+                                                                        memo_ttl, memo_max_entries,
+                                                                        std::move(action_matcher), fac_ctx.scope(), stats_prefix));
+
+  if (json_config.hasObject("shed")) {
+    Json::ObjectSharedPtr shed = json_config.getObject("shed");
+    config->setShedding(fac_ctx.runtime(), shed->getString("runtime_key", shedRuntimeKey(json_config.getString("stat_prefix", ""))),
+                        shed->getInteger("default_send_percent", 100),
+                        shed->getString("action", "passthrough") == "error" ? Http::InjectFilterConfig::ShedAction::Error
+                                                                            : Http::InjectFilterConfig::ShedAction::Passthrough);
+  }
+
+  if (json_config.hasObject("concurrency_limit")) {
+    Json::ObjectSharedPtr limit = json_config.getObject("concurrency_limit");
+    config->setConcurrencyLimit(concurrencyLimit(
+        limit->getInteger("initial_limit", 20), limit->getInteger("min_limit", 1), limit->getInteger("max_limit", 1000),
+        limit->getInteger("sample_window_ms", 250), limit->getInteger("baseline_windows", 20),
+        limit->getDouble("tolerance", 1.5), limit->getString("over_limit_action", "error") == "passthrough"));
+  }
+
+  std::map<std::string, Http::InjectFilterConfigSharedPtr> route_configs;
+  if (json_config.hasObject("route_configs")) {
+    json_config.getObject("route_configs")->iterate([&](const std::string& name, const Json::Object& route) {
+        route_configs[name] = routeConfig(*config, route.getString("cluster_name", ""), route.getInteger("timeout_ms", 0),
+                                          createActionMatcher(route.hasObject("actions") ? route : json_config), fac_ctx);
+        return true;
+      });
+  }
+  config->setRouteConfigs(json_config.getString("stat_prefix", ""), std::move(route_configs));
+  return config;
+}
+
+inject::InjectConfig InjectFilterConfig::typedConfig(const Json::Object& json_config) {
+  uint32_t fields = 0;
+  json_config.iterate([&fields](const std::string&, const Json::Object&) {
+      fields++;
+      return true;
+    });
+  if (fields != 1) {
+    throw EnvoyException("Inject filter typed_config cannot be mixed with JSON config fields");
+  }
+  // the typed config is read from the JSON already parsed rather than
+  // written out and parsed again
+  inject::InjectConfig proto_config;
+  try {
+    jsonToMessage(*json_config.getObject("typed_config"), proto_config);
+  } catch (const EnvoyException& e) {
+    throw EnvoyException(std::string("Inject filter typed_config is not a valid InjectConfig: ") + e.what());
+  }
+  return proto_config;
+}
+
+Http::InjectFilterConfigSharedPtr InjectFilterConfig::createConfig(const inject::InjectConfig& proto_config,
+                                                                   const std::string& stat_prefix,
+                                                                   FactoryContext& fac_ctx) {
+  // what the JSON schema would have checked
+  if (proto_config.cluster_name().empty()) {
+    throw EnvoyException("Inject filter typed_config requires cluster_name");
+  }
+  for (const inject::InjectConfig::Action& action : proto_config.actions()) {
+    if (action.result().empty()) {
+      throw EnvoyException("Inject filter typed_config action requires a result");
+    }
+  }
+  for (const auto& route : proto_config.route_configs()) {
+    for (const inject::InjectConfig::Action& action : route.second.actions()) {
+      if (action.result().empty()) {
+        throw EnvoyException("Inject filter typed_config action requires a result");
+      }
+    }
+  }
+  if (proto_config.has_capture() &&
+      (proto_config.capture().path().empty() || proto_config.capture().sample_percent() < 0 ||
+       proto_config.capture().sample_percent() > 100)) {
+    throw EnvoyException("Inject filter typed_config capture requires a path and sample_percent in [0, 100]");
+  }
+  if (proto_config.has_shed() && proto_config.shed().default_send_percent() > 100) {
+    throw EnvoyException("Inject filter typed_config shed default_send_percent must be at most 100");
+  }
+  if (proto_config.has_connection_memo() && proto_config.connection_memo().ttl_ms() == 0) {
+    throw EnvoyException("Inject filter typed_config connection_memo requires ttl_ms");
+  }
+
+  std::vector<Http::InjectHeaderData> trigger_headers;
+  std::vector<std::string> trigger_cookie_names;
+  for (const inject::InjectConfig::HeaderMatch& match : proto_config.trigger_headers()) {
+    if (match.name().find("cookie.") == 0) {
+      trigger_cookie_names.push_back(match.name().substr(7));
+      continue;
+    }
+    trigger_headers.emplace_back(match);
+  }
+
+  std::vector<Http::InjectHeaderData> antitrigger_headers;
+  for (const inject::InjectConfig::HeaderMatch& match : proto_config.antitrigger_headers()) {
+    antitrigger_headers.emplace_back(match);
+  }
+
+  std::vector<Http::LowerCaseString> inc_hdrs_lc = lowerCaseStrings(proto_config.include_headers());
+  std::vector<Http::LowerCaseString> route_hdrs_lc = lowerCaseStrings(proto_config.route_headers());
+  std::map<std::string,std::string> params(proto_config.params().begin(), proto_config.params().end());
+
+  Http::InjectActionMatcherPtr action_matcher = createActionMatcher(proto_config);
+
+  Http::InjectFilterConfig::BufferOverflowAction buffer_overflow_action = Http::InjectFilterConfig::BufferOverflowAction::Pause;
+  if (proto_config.buffer_overflow_action() == inject::InjectConfig::ABORT) {
+    buffer_overflow_action = Http::InjectFilterConfig::BufferOverflowAction::Abort;
+  } else if (proto_config.buffer_overflow_action() == inject::InjectConfig::ERROR_ACTION) {
+    buffer_overflow_action = Http::InjectFilterConfig::BufferOverflowAction::ErrorAction;
+  }
+
+  const bool always_triggered = proto_config.always_triggered();
+  bool disabled = proto_config.always_triggered_present_case() == inject::InjectConfig::kAlwaysTriggered &&
+                  !always_triggered && trigger_headers.empty() && trigger_cookie_names.empty();
+  if (trigger_headers.empty() && trigger_cookie_names.empty() && !always_triggered && !disabled) {
+    throw EnvoyException("Inject filter requires a non-empty trigger_headers list or always_triggered to be explicitly set.");
+  }
+
+  checkCluster(fac_ctx, proto_config.cluster_name());
+  Http::InjectCaptureSharedPtr capture;
+  if (proto_config.has_capture()) {
+    const inject::InjectConfig::Capture& capture_config = proto_config.capture();
+    capture.reset(new Http::InjectCapture(
+        fac_ctx.accessLogManager().createAccessLog(capture_config.path()), fac_ctx.random(),
+        capture_config.sample_percent_present_case() == inject::InjectConfig::Capture::kSamplePercent
+            ? capture_config.sample_percent() : 100,
+        capture_config.max_bytes() ? capture_config.max_bytes() : 100 * 1024 * 1024));
+  }
+
+  std::chrono::milliseconds memo_ttl(0);
+  uint64_t memo_max_entries = 0;
+  if (proto_config.has_connection_memo()) {
+    memo_ttl = std::chrono::milliseconds(proto_config.connection_memo().ttl_ms());
+    memo_max_entries = proto_config.connection_memo().max_entries() ? proto_config.connection_memo().max_entries() : 10000;
+  }
+
+  std::string stats_prefix = stat_prefix + "inject.";
+  if (!proto_config.stat_prefix().empty()) {
+    stats_prefix += proto_config.stat_prefix() + ".";
+  }
+
+  Http::InjectFilterConfigSharedPtr config(new Http::InjectFilterConfig(
+      trigger_headers, trigger_cookie_names, antitrigger_headers, always_triggered, inc_hdrs_lc,
+      proto_config.include_all_headers(), route_hdrs_lc, params, fac_ctx.clusterManager(),
+      proto_config.cluster_name(), proto_config.timeout_ms() ? proto_config.timeout_ms() : 120,
+      proto_config.max_buffer_bytes(), buffer_overflow_action, proto_config.speculative_connect(), capture,
+      memo_ttl, memo_max_entries, std::move(action_matcher), fac_ctx.scope(), stats_prefix));
+
+  if (proto_config.has_shed()) {
+    const inject::InjectConfig::Shed& shed = proto_config.shed();
+    config->setShedding(fac_ctx.runtime(),
+                        shed.runtime_key().empty() ? shedRuntimeKey(proto_config.stat_prefix()) : shed.runtime_key(),
+                        shed.default_send_percent_present_case() == inject::InjectConfig::Shed::kDefaultSendPercent
+                            ? shed.default_send_percent() : 100,
+                        shed.action() == inject::InjectConfig::Shed::LOCAL_ERROR ? Http::InjectFilterConfig::ShedAction::Error
+                                                                                 : Http::InjectFilterConfig::ShedAction::Passthrough);
+  }
+
+  if (proto_config.has_concurrency_limit()) {
+    const inject::InjectConfig::ConcurrencyLimit& limit = proto_config.concurrency_limit();
+    if (limit.tolerance() != 0 && limit.tolerance() < 1) {
+      throw EnvoyException("Inject filter typed_config concurrency_limit tolerance must be at least 1");
+    }
+    config->setConcurrencyLimit(concurrencyLimit(
+        limit.initial_limit() ? limit.initial_limit() : 20, limit.min_limit() ? limit.min_limit() : 1,
+        limit.max_limit() ? limit.max_limit() : 1000, limit.sample_window_ms() ? limit.sample_window_ms() : 250,
+        limit.baseline_windows() ? limit.baseline_windows() : 20, limit.tolerance() != 0 ? limit.tolerance() : 1.5,
+        limit.over_limit_action() == inject::InjectConfig::ConcurrencyLimit::PASSTHROUGH));
+  }
+
+  std::map<std::string, Http::InjectFilterConfigSharedPtr> route_configs;
+  for (const auto& route : proto_config.route_configs()) {
+    route_configs[route.first] = routeConfig(
+        *config, route.second.cluster_name(), route.second.timeout_ms(),
+        actionMatcher(route.second.actions().empty() ? proto_config.actions() : route.second.actions()), fac_ctx);
+  }
+  config->setRouteConfigs(proto_config.stat_prefix(), std::move(route_configs));
+  return config;
+}
+
+Http::InjectActionMatcherPtr InjectFilterConfig::createActionMatcher(const Json::Object& json_config) {
+  std::unique_ptr<Http::InjectActionMatcher> action_matcher;
   if (json_config.hasObject("actions") ) {
     std::vector<Json::ObjectSharedPtr> actions = json_config.getObjectArray("actions");
-    action_matcher = new Http::InjectActionMatcher(actions.size());
+    action_matcher.reset(new Http::InjectActionMatcher(actions.size()));
     for (Json::ObjectSharedPtr action: actions) {
 
       std::vector<Http::LowerCaseString> upstream_inject_headers_lc;
@@ -257,7 +802,12 @@ Http::InjectFilterConfigSharedPtr InjectFilterConfig::createConfig(const Json::O
 
       const bool upstream_inject_any  = action->getBoolean("upstream_inject_any", false);
       const bool downstream_inject_any  = action->getBoolean("downstream_inject_any", false);
-      std::map<std::string,std::string> response_headers; // fixme
+      std::map<std::string,std::string> response_headers;
+      if (action->hasObject("response_headers")) {
+        for (const Json::ObjectSharedPtr& header : action->getObjectArray("response_headers")) {
+          response_headers[header->getString("key")] = header->getString("value", "");
+        }
+      }
 
       /*
       std::vector<std::string> result;
@@ -272,34 +822,86 @@ Http::InjectFilterConfigSharedPtr InjectFilterConfig::createConfig(const Json::O
                            upstream_remove_headers_lc, upstream_remove_cookie_names,
                            downstream_inject_headers_lc, downstream_inject_any,
                            downstream_remove_headers_lc, action->getBoolean("use_rpc_response",false),
-                           action->getInteger("response_code",500), response_headers, action->getString("response_body","")));
+                           action->getInteger("response_code",500), response_headers, action->getString("response_body",""),
+                           action->getBoolean("redo_routing", false)));
 
     }
+  } else {
+    action_matcher.reset(new Http::InjectActionMatcher(0));
   }
+  return std::move(action_matcher);
+}
 
-  const std::string& cluster_name = json_config.getString("cluster_name");
-  const int64_t timeout_ms = json_config.getInteger("timeout_ms", 120);
-  const bool always_triggered = json_config.getBoolean("always_triggered", false);
-  const bool include_all_headers = json_config.getBoolean("include_all_headers", false);
+Http::InjectActionMatcherPtr InjectFilterConfig::createActionMatcher(const inject::InjectConfig& proto_config) {
+  return actionMatcher(proto_config.actions());
+}
 
-  bool always_triggered_not_specified  = json_config.getBoolean("always_triggered", true) && !json_config.getBoolean("always_triggered", false);
-  bool disabled = !always_triggered_not_specified && !always_triggered  && (trigger_headers.size() == 0) && (trigger_cookie_names.size() == 0);
+namespace {
+
+Http::InjectActionMatcherPtr actionMatcher(const google::protobuf::RepeatedPtrField<inject::InjectConfig::Action>& actions) {
+  std::unique_ptr<Http::InjectActionMatcher> action_matcher(new Http::InjectActionMatcher(actions.size()));
+  for (const inject::InjectConfig::Action& action : actions) {
+    std::vector<Http::LowerCaseString> upstream_inject_headers_lc = lowerCaseStrings(action.upstream_inject_headers());
+    std::vector<Http::LowerCaseString> upstream_remove_headers_lc;
+    std::vector<std::string> upstream_remove_cookie_names;
+    for (const std::string& element : action.upstream_remove_headers()) {
+      if (element.find("cookie.") == 0) {
+        upstream_remove_cookie_names.push_back(element.substr(7));
+        continue;
+      }
+      upstream_remove_headers_lc.push_back(Http::LowerCaseString(element));
+    }
+    std::vector<Http::LowerCaseString> downstream_inject_headers_lc = lowerCaseStrings(action.downstream_inject_headers());
+    std::vector<Http::LowerCaseString> downstream_remove_headers_lc = lowerCaseStrings(action.downstream_remove_headers());
+    std::map<std::string,std::string> response_headers;
+    for (const inject::Header& header : action.response_headers()) {
+      response_headers[header.key()] = header.value();
+    }
 
-  if ((trigger_headers.size() == 0) && (trigger_cookie_names.size() == 0) && !disabled) {
-    throw EnvoyException("Inject filter requires a non-empty trigger_headers list or always_triggered to be explicitly set.");
+    action_matcher->add(
+      Http::InjectAction(std::vector<std::string>(action.result().begin(), action.result().end()),
+                         action.action().empty() ? "passthrough" : action.action(),
+                         upstream_inject_headers_lc, action.upstream_inject_any(),
+                         upstream_remove_headers_lc, upstream_remove_cookie_names,
+                         downstream_inject_headers_lc, action.downstream_inject_any(),
+                         downstream_remove_headers_lc, action.use_rpc_response(),
+                         action.response_code() ? action.response_code() : 500, response_headers,
+                         action.response_body(), action.redo_routing()));
   }
+  return std::move(action_matcher);
+}
 
-  // no need to verify that any header injection could happen - inject could just be mirroring requests for review
+} // namespace
 
-  // verify that target cluster exists
-  if (!fac_ctx.clusterManager().get(cluster_name)) {
-    throw EnvoyException("Inject filter requires 'cluster_name' cluster for gRPC inject request to be configured statically in the config file. No such cluster: " + cluster_name);
+InjectConfigReloader::InjectConfigReloader(const std::string& path, const std::string& stat_prefix,
+                                           Http::InjectFilterConfigProviderSharedPtr provider,
+                                           FactoryContext& context)
+  : path_(path), stat_prefix_(stat_prefix), provider_(provider), context_(context),
+    watcher_(context.dispatcher().createFilesystemWatcher()) {
+  watcher_->addWatch(path_, Filesystem::Watcher::Events::MovedTo, [this](uint32_t) -> void {
+      reload();
+    });
+}
+
+bool InjectConfigReloader::reload() {
+  Http::InjectFilterConfigSharedPtr config;
+  try {
+    Json::ObjectSharedPtr json_config = Json::Factory::loadFromFile(path_);
+    config = InjectFilterConfig::createConfig(*json_config, stat_prefix_, context_);
+  } catch (const EnvoyException& e) {
+    ENVOY_LOG(warn, "inject config reload from {} failed, keeping current config: {}", path_, e.what());
+    provider_->config()->stats().config_reload_failed_.inc();
+    return false;
   }
-  // nice to have: ensure no dups in trig vs include hdrs
-  Http::InjectFilterConfigSharedPtr config(new Http::InjectFilterConfig(trigger_headers, trigger_cookie_names, antitrigger_headers,
-                                                                        always_triggered, inc_hdrs_lc, include_all_headers, params,
-                                                                        fac_ctx.clusterManager(), cluster_name, timeout_ms, *action_matcher));
-  return config;
+  ENVOY_LOG(info, "inject config reloaded from {}", path_);
+  // max_bytes bounds the capture file, not each config version
+  Http::InjectCapture* previous_capture = provider_->config()->capture();
+  if (config->capture() && previous_capture) {
+    config->capture()->continueFrom(*previous_capture);
+  }
+  config->stats().config_reload_.inc();
+  provider_->update(config);
+  return true;
 }
 
 
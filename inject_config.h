@@ -1,6 +1,8 @@
 #include <string>
 
+#include "envoy/filesystem/filesystem.h"
 #include "envoy/server/filter_config.h"
+#include "common/common/logger.h"
 #include "common/json/json_loader.h"
 #include "inject.h"
 
@@ -18,11 +20,49 @@ public:
                                           const std::string& stat_prefix,
                                           FactoryContext& context) override;
 
+  // json_config is either the JSON fields or a lone "typed_config"
+  // holding an inject::InjectConfig in proto3 JSON
   static Http::InjectFilterConfigSharedPtr createConfig(const Json::Object& json_config,
                                                         const std::string& stat_prefix,
                                                         FactoryContext& context);
+
+  static Http::InjectFilterConfigSharedPtr createConfig(const inject::InjectConfig& proto_config,
+                                                        const std::string& stat_prefix,
+                                                        FactoryContext& context);
+
+  // the "typed_config" of a filter config, parsed and checked
+  static inject::InjectConfig typedConfig(const Json::Object& json_config);
+
+  // the action table from a validated config's "actions"; shared with
+  // the network inject filter
+  static Http::InjectActionMatcherPtr createActionMatcher(const Json::Object& json_config);
+  static Http::InjectActionMatcherPtr createActionMatcher(const inject::InjectConfig& proto_config);
+};
+
+/**
+ * Watches an inject filter config file and publishes a new config
+ * snapshot through the provider each time the file is moved into
+ * place (write elsewhere then rename, as for runtime). A file that
+ * fails to load leaves the current snapshot in effect.
+ */
+class InjectConfigReloader : Logger::Loggable<Logger::Id::config> {
+public:
+  InjectConfigReloader(const std::string& path, const std::string& stat_prefix,
+                       Http::InjectFilterConfigProviderSharedPtr provider,
+                       FactoryContext& context);
+
+  // main thread: rebuild the config from the file and swap it in
+  bool reload();
+
+private:
+  const std::string path_;
+  const std::string stat_prefix_;
+  Http::InjectFilterConfigProviderSharedPtr provider_;
+  FactoryContext& context_;
+  Filesystem::WatcherPtr watcher_;
 };
 
+typedef std::shared_ptr<InjectConfigReloader> InjectConfigReloaderSharedPtr;
 
 } // Configuration
 } // Server
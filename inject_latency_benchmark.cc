@@ -0,0 +1,240 @@
+// End to end latency benchmark for the inject filter. Runs the same
+// request sequence through two listeners of one Envoy, one with the
+// inject filter and one without, against in-process fake upstreams.
+// The fake injector answers each inject RPC after a scripted delay with
+// a scripted result. Reports p50/p99/p999 latency for both listeners,
+// the latency the inject listener adds, inject RPCs per second and CPU
+// per request.
+//
+// bazel test //:inject_latency_benchmark --test_output=streamed \
+//   --test_env=INJECT_BENCH_REQUESTS=2000 --test_env=INJECT_BENCH_RPS=500 \
+//   --test_env=INJECT_BENCH_INJECTOR_LATENCY_US=200,200,200,1000 \
+//   --test_env=INJECT_BENCH_RESULTS=ok,ok,ok,deny
+//
+// INJECT_BENCH_REQUESTS    requests per listener (default 200)
+// INJECT_BENCH_RPS         target request rate, 0 for back to back (default 0)
+// INJECT_BENCH_INJECTOR_LATENCY_US
+//                          injector delays in us, used in turn (default 0)
+// INJECT_BENCH_RESULTS     injector results, used in turn (default ok);
+//                          "deny" aborts with 403 without going upstream
+//
+// Everything runs in this process, so CPU per request covers Envoy, the
+// client and the fake upstreams; the difference between the listeners
+// is what the inject filter and its RPC cost.
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include "common/common/utility.h"
+#include "common/grpc/common.h"
+#include "inject.pb.h"
+
+#include "test/integration/http_integration.h"
+#include "test/integration/utility.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace {
+
+std::string envOr(const char* name, const std::string& default_value) {
+  const char* value = ::getenv(name);
+  return value && *value ? value : default_value;
+}
+
+struct LatencySummary {
+  std::chrono::microseconds p50_;
+  std::chrono::microseconds p99_;
+  std::chrono::microseconds p999_;
+};
+
+LatencySummary summarize(std::vector<std::chrono::microseconds> latencies) {
+  std::sort(latencies.begin(), latencies.end());
+  auto at = [&latencies](double q) {
+    size_t rank = std::max<size_t>(1, std::ceil(q * latencies.size()));
+    return latencies[rank - 1];
+  };
+  return {at(0.5), at(0.99), at(0.999)};
+}
+
+std::chrono::microseconds cpuTime() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+         std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+} // namespace
+
+class InjectLatencyBenchmark : public HttpIntegrationTest,
+                               public testing::TestWithParam<Network::Address::IpVersion> {
+public:
+  InjectLatencyBenchmark() : HttpIntegrationTest(Http::CodecClient::Type::HTTP1, GetParam()) {}
+
+  static const int UPSTREAM_STREAM_IND = 0;
+  static const int INJECT0_STREAM_IND = 1;
+
+  // one listener's run
+  struct Run {
+    std::vector<std::chrono::microseconds> latencies_;
+    // latency less the scripted injector delay
+    std::vector<std::chrono::microseconds> filter_latencies_;
+    std::chrono::microseconds wall_{};
+    std::chrono::microseconds cpu_{};
+    uint64_t rpcs_{};
+  };
+
+  void SetUp() override {
+    fake_upstreams_.emplace_back(new FakeUpstream(0, FakeHttpConnection::Type::HTTP2, version_));
+    registerPort("traffic_0", fake_upstreams_.back()->localAddress()->ip()->port());
+    fake_upstreams_.emplace_back(new FakeUpstream(0, FakeHttpConnection::Type::HTTP2, version_));
+    registerPort("injector0_0", fake_upstreams_.back()->localAddress()->ip()->port());
+    createTestServer("inject_latency_benchmark_server.json", {"http", "http_baseline"});
+
+    requests_ = std::stoul(envOr("INJECT_BENCH_REQUESTS", "200"));
+    rps_ = std::stoul(envOr("INJECT_BENCH_RPS", "0"));
+    for (const std::string& delay :
+         StringUtil::split(envOr("INJECT_BENCH_INJECTOR_LATENCY_US", "0"), ',')) {
+      injector_delays_.push_back(std::chrono::microseconds(std::stoul(delay)));
+    }
+    injector_results_ = StringUtil::split(envOr("INJECT_BENCH_RESULTS", "ok"), ',');
+  }
+
+  void TearDown() override {
+    if (fake_inject0_connection_ != nullptr) {
+      fake_inject0_connection_->close();
+      fake_inject0_connection_->waitForDisconnect();
+    }
+    if (fake_upstream_connection_ != nullptr) {
+      fake_upstream_connection_->close();
+      fake_upstream_connection_->waitForDisconnect();
+    }
+    test_server_.reset();
+    fake_upstreams_.clear();
+  }
+
+  // answer the next inject RPC after the scripted delay; returns the
+  // time actually spent waiting
+  std::chrono::microseconds answerInjectRequest(uint64_t i, const std::string& result) {
+    if (fake_inject0_connection_ == nullptr) {
+      fake_inject0_connection_ = fake_upstreams_[INJECT0_STREAM_IND]->waitForHttpConnection(*dispatcher_);
+    }
+    FakeStreamPtr inject_request = fake_inject0_connection_->waitForNewStream();
+    inject_request->waitForEndStream(*dispatcher_);
+
+    MonotonicTime start = std::chrono::steady_clock::now();
+    std::chrono::microseconds delay = injector_delays_[i % injector_delays_.size()];
+    if (delay.count() > 0) {
+      std::this_thread::sleep_for(delay);
+    }
+
+    inject::InjectResponse response_msg;
+    response_msg.set_result(result);
+    inject::Header* ih = response_msg.mutable_upstreamheaders()->Add();
+    ih->set_key("x-myco-jwt");
+    ih->set_value("(a-signed-jwt)");
+    inject_request->encodeHeaders(Http::TestHeaderMapImpl{{":status", "200"}}, false);
+    inject_request->encodeData(*Grpc::Common::serializeBody(response_msg), false);
+    inject_request->encodeTrailers(Http::TestHeaderMapImpl{{"grpc-status", "0"}});
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  }
+
+  void answerUpstreamRequest() {
+    if (fake_upstream_connection_ == nullptr) {
+      fake_upstream_connection_ = fake_upstreams_[UPSTREAM_STREAM_IND]->waitForHttpConnection(*dispatcher_);
+    }
+    FakeStreamPtr upstream_request = fake_upstream_connection_->waitForNewStream();
+    upstream_request->waitForEndStream(*dispatcher_);
+    upstream_request->encodeHeaders(Http::TestHeaderMapImpl{{":status", "200"}}, true);
+  }
+
+  Run run(const std::string& port_name, bool inject, uint64_t requests) {
+    IntegrationCodecClientPtr codec_client = makeHttpConnection(makeClientConnection(lookupPort(port_name)));
+    Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/some/path?qp1=foo&qp2=bar"},
+                                    {":scheme", "http"}, {":authority", "host"},
+                                    {"cookie", "sessId=123"}, {"x-forwarded-for", "10.0.0.1"}};
+    Run result;
+    MonotonicTime run_start = std::chrono::steady_clock::now();
+    std::chrono::microseconds cpu_start = cpuTime();
+    for (uint64_t i = 0; i < requests; i++) {
+      if (rps_ > 0) {
+        std::this_thread::sleep_until(run_start + std::chrono::microseconds(i * 1000000 / rps_));
+      }
+      const std::string& injector_result = injector_results_[i % injector_results_.size()];
+      bool upstream = !inject || injector_result != "deny";
+      IntegrationStreamDecoderPtr response(new IntegrationStreamDecoder(*dispatcher_));
+
+      MonotonicTime start = std::chrono::steady_clock::now();
+      codec_client->makeHeaderOnlyRequest(headers, *response);
+      std::chrono::microseconds injector_time{};
+      if (inject) {
+        injector_time = answerInjectRequest(i, injector_result);
+        result.rpcs_++;
+      }
+      if (upstream) {
+        answerUpstreamRequest();
+      }
+      response->waitForEndStream();
+      std::chrono::microseconds latency =
+          std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+      EXPECT_STREQ(upstream ? "200" : "403", response->headers().Status()->value().c_str());
+      result.latencies_.push_back(latency);
+      result.filter_latencies_.push_back(latency - injector_time);
+    }
+    result.wall_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - run_start);
+    result.cpu_ = cpuTime() - cpu_start;
+    codec_client->close();
+    return result;
+  }
+
+  uint64_t requests_;
+  uint64_t rps_;
+  std::vector<std::chrono::microseconds> injector_delays_;
+  std::vector<std::string> injector_results_;
+  FakeHttpConnectionPtr fake_upstream_connection_;
+  FakeHttpConnectionPtr fake_inject0_connection_;
+};
+
+INSTANTIATE_TEST_CASE_P(IpVersions, InjectLatencyBenchmark,
+                        testing::ValuesIn(TestEnvironment::getIpVersionsForTest()));
+
+TEST_P(InjectLatencyBenchmark, AddedLatency) {
+  // warm up connections on both listeners and to both upstreams
+  run("http_baseline", false, 10);
+  run("http", true, 10);
+
+  Run baseline = run("http_baseline", false, requests_);
+  Run inject = run("http", true, requests_);
+
+  LatencySummary base = summarize(baseline.latencies_);
+  LatencySummary with = summarize(inject.latencies_);
+  LatencySummary filter = summarize(inject.filter_latencies_);
+  auto row = [](const std::string& name, const LatencySummary& s) {
+    return fmt::format("{:<34}{:>10}{:>10}{:>10}\n", name, s.p50_.count(), s.p99_.count(), s.p999_.count());
+  };
+  auto added = [](const LatencySummary& a, const LatencySummary& b) {
+    return LatencySummary{a.p50_ - b.p50_, a.p99_ - b.p99_, a.p999_ - b.p999_};
+  };
+  double cpu_base = static_cast<double>(baseline.cpu_.count()) / requests_;
+  double cpu_inject = static_cast<double>(inject.cpu_.count()) / requests_;
+
+  std::cout << fmt::format("\n{} requests per listener, target rate {}\n", requests_,
+                           rps_ ? std::to_string(rps_) + "/s" : "unpaced")
+            << fmt::format("{:<34}{:>10}{:>10}{:>10}\n", "latency (us)", "p50", "p99", "p999")
+            << row("baseline", base) << row("inject", with) << row("added", added(with, base))
+            << row("added less injector delay", added(filter, base))
+            << fmt::format("inject RPCs/s: {:.0f}\n", inject.rpcs_ * 1e6 / inject.wall_.count())
+            << fmt::format("CPU us/request: baseline {:.1f}, inject {:.1f}, added {:.1f}\n", cpu_base,
+                           cpu_inject, cpu_inject - cpu_base);
+}
+
+} // Envoy
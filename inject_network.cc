@@ -0,0 +1,161 @@
+#include "inject_network.h"
+
+#include <algorithm>
+
+#include "envoy/network/address.h"
+#include "envoy/ssl/connection.h"
+
+#include "common/common/assert.h"
+
+namespace Envoy {
+namespace Filter {
+
+void NetworkInjectFilter::initializeReadFilterCallbacks(Network::ReadFilterCallbacks& callbacks) {
+  read_callbacks_ = &callbacks;
+  read_callbacks_->connection().addConnectionCallbacks(*this);
+}
+
+Network::FilterStatus NetworkInjectFilter::onNewConnection() {
+  config_->stats().cx_total_.inc();
+  if (config_->first_bytes() > 0) {
+    // the request goes out with the first read, which still comes to
+    // this filter; later filters are not started until the result
+    return Network::FilterStatus::StopIteration;
+  }
+  sendInjectRequest(nullptr);
+  return state_ == State::Allowed ? Network::FilterStatus::Continue : Network::FilterStatus::StopIteration;
+}
+
+Network::FilterStatus NetworkInjectFilter::onData(Buffer::Instance& data) {
+  switch (state_) {
+  case State::Allowed:
+    return Network::FilterStatus::Continue;
+  case State::NotStarted:
+    sendInjectRequest(&data);
+    return state_ == State::Allowed ? Network::FilterStatus::Continue : Network::FilterStatus::StopIteration;
+  case State::Waiting:
+  case State::Closed:
+    // left in the connection's read buffer until the result arrives
+    return Network::FilterStatus::StopIteration;
+  }
+  NOT_REACHED;
+}
+
+void NetworkInjectFilter::sendInjectRequest(const Buffer::Instance* data) {
+  Network::Connection& connection = read_callbacks_->connection();
+  inject::InjectRequest ir;
+  auto add = [&ir](const std::string& key, const std::string& value) -> void {
+    inject::Header* ih = ir.mutable_inputheaders()->Add();
+    ih->set_key(key);
+    ih->set_value(value);
+  };
+  add("source.address", connection.remoteAddress().asString());
+  if (connection.remoteAddress().ip()) {
+    add("source.ip", connection.remoteAddress().ip()->addressAsString());
+  }
+  add("destination.address", connection.localAddress().asString());
+  if (connection.ssl()) {
+    add("tls.peer_subject", connection.ssl()->subjectPeerCertificate());
+    add("tls.peer_uri_san", connection.ssl()->uriSanPeerCertificate());
+  }
+  if (data) {
+    std::string first(std::min<uint64_t>(data->length(), config_->first_bytes()), '\0');
+    data->copyOut(0, first.size(), &first[0]);
+    add("first_bytes", first);
+  }
+  google::protobuf::Map<std::string, std::string>* params = ir.mutable_params();
+  for (const auto& param : config_->params()) {
+    (*params)[param.first] = param.second;
+  }
+
+  state_ = State::Waiting;
+  rpc_outstanding_ = true;
+  config_->stats().rpc_active_.inc();
+  rpc_start_ = std::chrono::steady_clock::now();
+  rpc_latency_ = config_->stats().rpc_latency_.allocateSpan();
+  client_ = config_->inject_client();
+  sending_ = true;
+  req_ = client_->send(config_->method_descriptor(), ir, *this, std::chrono::milliseconds(config_->timeout_ms()));
+
+  if (!req_ && rpc_outstanding_) {
+    // not already reported through onFailure()
+    ENVOY_CONN_LOG(warn, "inject: could not send inject request, using error action", connection);
+    config_->stats().rpc_failure_.inc();
+    onRpcComplete();
+    applyAction(config_->action_matcher().errorAction(), "");
+  }
+  sending_ = false;
+  if (state_ == State::Waiting) {
+    // hold further reads in the kernel rather than Envoy's buffer
+    connection.readDisable(true);
+  }
+}
+
+void NetworkInjectFilter::onSuccess(std::unique_ptr<inject::InjectResponse>&& response) {
+  req_ = nullptr;
+  config_->stats().rpc_success_.inc();
+  onRpcComplete();
+  applyAction(config_->action_matcher().match(response->result()), response->action());
+}
+
+void NetworkInjectFilter::onFailure(Grpc::Status::GrpcStatus status, const std::string& message) {
+  req_ = nullptr;
+  ENVOY_CONN_LOG(warn, "inject: inject request failed ({}): {}", read_callbacks_->connection(), status, message);
+  if (status == Grpc::Status::GrpcStatus::DeadlineExceeded ||
+      std::chrono::steady_clock::now() - rpc_start_ >= std::chrono::milliseconds(config_->timeout_ms())) {
+    config_->stats().rpc_timeout_.inc();
+  } else {
+    config_->stats().rpc_failure_.inc();
+  }
+  onRpcComplete();
+  applyAction(config_->action_matcher().errorAction(), "");
+}
+
+void NetworkInjectFilter::onRpcComplete() {
+  if (rpc_outstanding_) {
+    rpc_outstanding_ = false;
+    config_->stats().rpc_active_.dec();
+  }
+  if (rpc_latency_) {
+    rpc_latency_->complete();
+    rpc_latency_.reset();
+  }
+}
+
+void NetworkInjectFilter::applyAction(const Http::InjectAction& action, const std::string& dynamic_action) {
+  const std::string& name = action.action_ == "dynamic" ? dynamic_action : action.action_;
+  Network::Connection& connection = read_callbacks_->connection();
+  const bool was_waiting = state_ == State::Waiting;
+  if (name == "abort") {
+    ENVOY_CONN_LOG(debug, "inject: closing connection", connection);
+    state_ = State::Closed;
+    config_->stats().cx_closed_.inc();
+    connection.close(Network::ConnectionCloseType::NoFlush);
+    return;
+  }
+
+  state_ = State::Allowed;
+  config_->stats().cx_allowed_.inc();
+  // a result arriving during send() is picked up by the caller
+  if (was_waiting && !sending_) {
+    connection.readDisable(false);
+    read_callbacks_->continueReading();
+  }
+}
+
+void NetworkInjectFilter::onEvent(Network::ConnectionEvent event) {
+  if (event != Network::ConnectionEvent::RemoteClose && event != Network::ConnectionEvent::LocalClose) {
+    return;
+  }
+  if (req_) {
+    req_->cancel();
+    req_ = nullptr;
+  }
+  onRpcComplete();
+  if (state_ == State::Waiting) {
+    state_ = State::Closed;
+  }
+}
+
+} // Filter
+} // Envoy
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/network/connection.h"
+#include "envoy/network/filter.h"
+#include "envoy/stats/stats_macros.h"
+#include "envoy/upstream/cluster_manager.h"
+
+#include "common/common/logger.h"
+#include "common/grpc/async_client_impl.h"
+#include "inject.h"
+#include "inject.pb.h"
+
+namespace Envoy {
+namespace Filter {
+
+/**
+ * All network inject filter stats. @see stats_macros.h
+ */
+// clang-format off
+#define ALL_NETWORK_INJECT_STATS(COUNTER, GAUGE, TIMER)                                           \
+  COUNTER(cx_total)                                                                               \
+  COUNTER(cx_allowed)                                                                             \
+  COUNTER(cx_closed)                                                                              \
+  COUNTER(rpc_success)                                                                            \
+  COUNTER(rpc_failure)                                                                            \
+  COUNTER(rpc_timeout)                                                                            \
+  GAUGE  (rpc_active)                                                                             \
+  TIMER  (rpc_latency)
+// clang-format on
+
+/**
+ * Struct definition for all network inject filter stats. @see stats_macros.h
+ */
+struct NetworkInjectStats {
+  ALL_NETWORK_INJECT_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT, GENERATE_TIMER_STRUCT)
+};
+
+/**
+ * Configuration for the network inject filter, shared by all its
+ * connections.
+ */
+class NetworkInjectConfig {
+public:
+  NetworkInjectConfig(Upstream::ClusterManager& cluster_mgr, const std::string& cluster_name, int64_t timeout_ms,
+                      const std::map<std::string, std::string>& params, uint64_t first_bytes,
+                      Http::InjectActionMatcherPtr&& action_matcher, Stats::Scope& scope,
+                      const std::string& stats_prefix)
+      : cluster_mgr_(cluster_mgr), cluster_name_(cluster_name), timeout_ms_(timeout_ms), params_(params),
+        first_bytes_(first_bytes), action_matcher_(std::move(action_matcher)),
+        method_descriptor_(
+            *Protobuf::DescriptorPool::generated_pool()->FindMethodByName("inject.InjectService.InjectHeaders")),
+        stats_{ALL_NETWORK_INJECT_STATS(POOL_COUNTER_PREFIX(scope, stats_prefix),
+                                        POOL_GAUGE_PREFIX(scope, stats_prefix),
+                                        POOL_TIMER_PREFIX(scope, stats_prefix))} {}
+
+  const std::string& cluster_name() const { return cluster_name_; }
+  int64_t timeout_ms() const { return timeout_ms_; }
+  const std::map<std::string, std::string>& params() const { return params_; }
+  // how much of the first read goes in the inject request; 0 sends the
+  // request as soon as the connection is accepted
+  uint64_t first_bytes() const { return first_bytes_; }
+  const Http::InjectActionMatcher& action_matcher() const { return *action_matcher_; }
+  const google::protobuf::MethodDescriptor& method_descriptor() const { return method_descriptor_; }
+  NetworkInjectStats& stats() { return stats_; }
+
+  std::unique_ptr<Grpc::AsyncClientImpl<inject::InjectRequest, inject::InjectResponse>> inject_client() {
+    return std::unique_ptr<Grpc::AsyncClientImpl<inject::InjectRequest, inject::InjectResponse>>(
+        new Grpc::AsyncClientImpl<inject::InjectRequest, inject::InjectResponse>(cluster_mgr_, cluster_name_));
+  }
+
+private:
+  Upstream::ClusterManager& cluster_mgr_;
+  const std::string cluster_name_;
+  const int64_t timeout_ms_;
+  const std::map<std::string, std::string> params_;
+  const uint64_t first_bytes_;
+  const Http::InjectActionMatcherPtr action_matcher_;
+  const google::protobuf::MethodDescriptor& method_descriptor_;
+  NetworkInjectStats stats_;
+};
+
+typedef std::shared_ptr<NetworkInjectConfig> NetworkInjectConfigSharedPtr;
+
+/**
+ * Connection level inject filter: one InjectHeaders RPC per connection,
+ * built from the connection's addresses, TLS peer and optionally its
+ * first bytes. Reads are held (and later filters, e.g. tcp_proxy, not
+ * started) until the result arrives. An "abort" action closes the
+ * connection; any other lets it through for the rest of its life.
+ */
+class NetworkInjectFilter : public Network::ReadFilter,
+                            public Network::ConnectionCallbacks,
+                            public Grpc::AsyncRequestCallbacks<inject::InjectResponse>,
+                            Logger::Loggable<Logger::Id::filter> {
+public:
+  NetworkInjectFilter(NetworkInjectConfigSharedPtr config) : config_(config) {}
+
+  // Network::ReadFilter
+  Network::FilterStatus onData(Buffer::Instance& data) override;
+  Network::FilterStatus onNewConnection() override;
+  void initializeReadFilterCallbacks(Network::ReadFilterCallbacks& callbacks) override;
+
+  // Network::ConnectionCallbacks
+  void onEvent(Network::ConnectionEvent event) override;
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
+
+  // Grpc::AsyncRequestCallbacks
+  void onCreateInitialMetadata(Http::HeaderMap&) override {}
+  void onSuccess(std::unique_ptr<inject::InjectResponse>&& response) override;
+  void onFailure(Grpc::Status::GrpcStatus status, const std::string& message) override;
+
+  enum class State { NotStarted, Waiting, Allowed, Closed };
+  State getState() { return state_; } // testing aid
+
+private:
+  void sendInjectRequest(const Buffer::Instance* data);
+  void onRpcComplete();
+  void applyAction(const Http::InjectAction& action, const std::string& dynamic_action);
+
+  NetworkInjectConfigSharedPtr config_;
+  Network::ReadFilterCallbacks* read_callbacks_{};
+  State state_{State::NotStarted};
+  std::unique_ptr<Grpc::AsyncClientImpl<inject::InjectRequest, inject::InjectResponse>> client_;
+  Grpc::AsyncRequest* req_{};
+  bool rpc_outstanding_{};
+  // inside client_->send(), which may complete the RPC synchronously
+  bool sending_{};
+  std::chrono::steady_clock::time_point rpc_start_;
+  Stats::TimespanPtr rpc_latency_;
+};
+
+} // Filter
+} // Envoy
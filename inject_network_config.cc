@@ -0,0 +1,113 @@
+#include "inject_network_config.h"
+
+#include <map>
+#include <string>
+
+#include "envoy/common/exception.h"
+#include "envoy/registry/registry.h"
+
+#include "inject_config.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+const std::string NETWORK_INJECT_SCHEMA(R"EOF(
+  {
+    "$schema": "http://json-schema.org/schema#",
+    "type" : "object",
+    "description": "JSON object to configure an instance of the connection level inject network filter",
+    "required": ["cluster_name"],
+    "additionalProperties": false,
+    "properties":{
+      "cluster_name": {
+        "type" : "string",
+        "description": "cluster of the gRPC injection service"
+      },
+      "timeout_ms": {
+        "type" : "integer",
+        "minimum" : 1,
+        "description": "inject RPC timeout. Defaults to 120."
+      },
+      "params" : {
+        "type" : "object",
+        "additionalProperties" : true,
+        "description": "opaque k/vs (string,string) passed to the injection service."
+      },
+      "first_bytes" : {
+        "type" : "integer",
+        "minimum" : 0,
+        "description": "send up to this many bytes of the connection's first read in the inject request, waiting for that read. Defaults to 0, sending the request when the connection is accepted."
+      },
+      "stat_prefix": {
+        "type" : "string",
+        "description": "distinguishes the stats of this filter from other network inject filters."
+      },
+      "actions": {
+        "type" : "array",
+        "description": "what to do with the connection for each result: abort closes it, passthrough lets it through, dynamic takes the action from the response.",
+        "items" : {
+          "type" : "object",
+          "required": ["result"],
+          "additionalProperties": false,
+          "properties":{
+            "result" : {
+              "type" : "array",
+              "minItems" : 1,
+              "items" : {"type" : "string"}
+            },
+            "action" : {
+              "type" : "string",
+              "enum" : ["passthrough", "abort", "dynamic"]
+            }
+          }
+        }
+      }
+    }
+  }
+)EOF");
+
+NetworkFilterFactoryCb NetworkInjectConfigFactory::createFilterFactory(const Json::Object& json_config,
+                                                                      FactoryContext& context) {
+  Filter::NetworkInjectConfigSharedPtr config = createConfig(json_config, context);
+  return [config](Network::FilterManager& filter_manager) -> void {
+    filter_manager.addReadFilter(Network::ReadFilterSharedPtr{new Filter::NetworkInjectFilter(config)});
+  };
+}
+
+Filter::NetworkInjectConfigSharedPtr NetworkInjectConfigFactory::createConfig(const Json::Object& json_config,
+                                                                             FactoryContext& context) {
+  json_config.validateSchema(NETWORK_INJECT_SCHEMA);
+
+  const std::string cluster_name = json_config.getString("cluster_name");
+  if (!context.clusterManager().get(cluster_name)) {
+    throw EnvoyException("network_inject filter requires 'cluster_name' cluster to be configured statically. No such cluster: " + cluster_name);
+  }
+
+  std::map<std::string, std::string> params;
+  if (json_config.hasObject("params")) {
+    json_config.getObject("params")->iterate([&params](const std::string& name, const Json::Object& value) {
+      params[name] = value.asString();
+      return true;
+    });
+  }
+
+  std::string stats_prefix = "network_inject.";
+  if (json_config.hasObject("stat_prefix")) {
+    stats_prefix += json_config.getString("stat_prefix") + ".";
+  }
+
+  return std::make_shared<Filter::NetworkInjectConfig>(
+      context.clusterManager(), cluster_name, json_config.getInteger("timeout_ms", 120), params,
+      json_config.getInteger("first_bytes", 0), InjectFilterConfig::createActionMatcher(json_config),
+      context.scope(), stats_prefix);
+}
+
+/**
+ * Static registration for the network inject filter. @see RegisterFactory.
+ */
+static Registry::RegisterFactory<NetworkInjectConfigFactory, NamedNetworkFilterConfigFactory> registered_;
+
+} // Configuration
+} // Server
+} // Envoy
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include "envoy/server/filter_config.h"
+
+#include "inject_network.h"
+
+namespace Envoy {
+namespace Server {
+namespace Configuration {
+
+/**
+ * Config registration for the connection level inject filter. @see NamedNetworkFilterConfigFactory.
+ */
+class NetworkInjectConfigFactory : public NamedNetworkFilterConfigFactory {
+public:
+  // NamedNetworkFilterConfigFactory
+  NetworkFilterFactoryCb createFilterFactory(const Json::Object& json_config, FactoryContext& context) override;
+  std::string name() override { return "network_inject"; }
+
+  static Filter::NetworkInjectConfigSharedPtr createConfig(const Json::Object& json_config,
+                                                           FactoryContext& context);
+};
+
+} // Configuration
+} // Server
+} // Envoy
@@ -0,0 +1,192 @@
+#include <memory>
+#include <string>
+
+#include "inject_network_config.h"
+#include "common/buffer/buffer_impl.h"
+#include "common/json/json_loader.h"
+
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/network/mocks.h"
+#include "test/mocks/server/mocks.h"
+#include "test/test_common/utility.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::_;
+
+namespace Filter {
+
+class NetworkInjectFilterTest : public testing::Test {
+public:
+  void setup(const std::string& json) {
+    Json::ObjectSharedPtr config = Json::Factory::loadFromString(json);
+    config_ = Server::Configuration::NetworkInjectConfigFactory::createConfig(*config, fac_ctx_);
+    filter_.reset(new NetworkInjectFilter(config_));
+    filter_->initializeReadFilterCallbacks(read_callbacks_);
+  }
+
+  void expectInjectRequestSent() {
+    EXPECT_CALL(fac_ctx_.cluster_manager_.async_client_, start(_, _)).WillOnce(Return(&async_stream_));
+  }
+
+  std::unique_ptr<inject::InjectResponse> response(const std::string& result) {
+    std::unique_ptr<inject::InjectResponse> resp(new inject::InjectResponse());
+    resp->set_result(result);
+    return resp;
+  }
+
+  uint64_t counter(const std::string& name) {
+    return fac_ctx_.scope_.counter("network_inject." + name).value();
+  }
+
+  const std::string config_json_ = R"EOF(
+  {
+    "cluster_name": "sessionCheck",
+    "actions": [
+      { "result": ["ok"], "action": "passthrough" },
+      { "result": ["deny"], "action": "abort" }
+    ]
+  }
+  )EOF";
+
+  NiceMock<Server::Configuration::MockFactoryContext> fac_ctx_;
+  NiceMock<Http::MockAsyncClientStream> async_stream_;
+  NiceMock<Network::MockReadFilterCallbacks> read_callbacks_;
+  NetworkInjectConfigSharedPtr config_;
+  std::unique_ptr<NetworkInjectFilter> filter_;
+};
+
+TEST_F(NetworkInjectFilterTest, BadConfigUnknownCluster) {
+  EXPECT_CALL(fac_ctx_.cluster_manager_, get("nope")).WillOnce(Return(nullptr));
+  EXPECT_THROW(setup(R"EOF({ "cluster_name": "nope" })EOF"), EnvoyException);
+}
+
+TEST_F(NetworkInjectFilterTest, BadConfigZeroTimeout) {
+  EXPECT_THROW(setup(R"EOF({ "cluster_name": "sessionCheck", "timeout_ms": 0 })EOF"), Json::Exception);
+}
+
+TEST_F(NetworkInjectFilterTest, AllowedConnectionContinues) {
+  setup(config_json_);
+  expectInjectRequestSent();
+  EXPECT_CALL(read_callbacks_.connection_, readDisable(true));
+  EXPECT_EQ(Network::FilterStatus::StopIteration, filter_->onNewConnection());
+  EXPECT_EQ(NetworkInjectFilter::State::Waiting, filter_->getState());
+  EXPECT_EQ(1U, fac_ctx_.scope_.gauge("network_inject.rpc_active").value());
+
+  Buffer::OwnedImpl data("hello");
+  EXPECT_EQ(Network::FilterStatus::StopIteration, filter_->onData(data));
+
+  EXPECT_CALL(read_callbacks_.connection_, readDisable(false));
+  EXPECT_CALL(read_callbacks_, continueReading());
+  filter_->onSuccess(response("ok"));
+  EXPECT_EQ(NetworkInjectFilter::State::Allowed, filter_->getState());
+  EXPECT_EQ(Network::FilterStatus::Continue, filter_->onData(data));
+  EXPECT_EQ(1U, counter("rpc_success"));
+  EXPECT_EQ(1U, counter("cx_allowed"));
+  EXPECT_EQ(0U, fac_ctx_.scope_.gauge("network_inject.rpc_active").value());
+}
+
+TEST_F(NetworkInjectFilterTest, AbortClosesConnection) {
+  setup(config_json_);
+  expectInjectRequestSent();
+  filter_->onNewConnection();
+
+  EXPECT_CALL(read_callbacks_, continueReading()).Times(0);
+  EXPECT_CALL(read_callbacks_.connection_, close(Network::ConnectionCloseType::NoFlush));
+  filter_->onSuccess(response("deny"));
+  EXPECT_EQ(NetworkInjectFilter::State::Closed, filter_->getState());
+  EXPECT_EQ(1U, counter("cx_closed"));
+}
+
+TEST_F(NetworkInjectFilterTest, ErrorUsesErrorAction) {
+  setup(config_json_);
+  expectInjectRequestSent();
+  filter_->onNewConnection();
+
+  // the default error action is abort
+  EXPECT_CALL(read_callbacks_.connection_, close(Network::ConnectionCloseType::NoFlush));
+  filter_->onFailure(Grpc::Status::GrpcStatus::Unavailable, "down");
+  EXPECT_EQ(1U, counter("rpc_failure"));
+}
+
+// a request that cannot be sent takes the error action before
+// onNewConnection() returns, so reading was never disabled
+TEST_F(NetworkInjectFilterTest, SendFailureUsesPassthroughErrorAction) {
+  setup(R"EOF(
+  {
+    "cluster_name": "sessionCheck",
+    "actions": [{ "result": ["local.error"], "action": "passthrough" }]
+  }
+  )EOF");
+  EXPECT_CALL(fac_ctx_.cluster_manager_.async_client_, start(_, _)).WillOnce(Return(nullptr));
+  EXPECT_CALL(read_callbacks_.connection_, readDisable(_)).Times(0);
+  EXPECT_CALL(read_callbacks_, continueReading()).Times(0);
+  EXPECT_EQ(Network::FilterStatus::Continue, filter_->onNewConnection());
+  EXPECT_EQ(NetworkInjectFilter::State::Allowed, filter_->getState());
+  EXPECT_EQ(1U, counter("rpc_failure"));
+  EXPECT_EQ(1U, counter("cx_allowed"));
+  EXPECT_EQ(0U, fac_ctx_.scope_.gauge("network_inject.rpc_active").value());
+}
+
+TEST_F(NetworkInjectFilterTest, FirstBytesSentWithFirstRead) {
+  setup(R"EOF(
+  {
+    "cluster_name": "sessionCheck",
+    "first_bytes": 4,
+    "params": { "service": "db" },
+    "actions": [{ "result": ["ok"], "action": "passthrough" }]
+  }
+  )EOF");
+  EXPECT_CALL(fac_ctx_.cluster_manager_.async_client_, start(_, _)).Times(0);
+  EXPECT_EQ(Network::FilterStatus::StopIteration, filter_->onNewConnection());
+
+  Buffer::InstancePtr sent;
+  expectInjectRequestSent();
+  EXPECT_CALL(async_stream_, sendData(_, _)).WillOnce(Invoke([&sent](Buffer::Instance& data, bool) -> void {
+    sent.reset(new Buffer::OwnedImpl());
+    sent->move(data);
+  }));
+  Buffer::OwnedImpl data("helloworld");
+  EXPECT_EQ(Network::FilterStatus::StopIteration, filter_->onData(data));
+  EXPECT_EQ(10U, data.length());
+
+  ASSERT_TRUE(sent != nullptr);
+  // skip the 5 byte gRPC frame header
+  sent->drain(5);
+  inject::InjectRequest request;
+  std::string serialized = TestUtility::bufferToString(*sent);
+  ASSERT_TRUE(request.ParseFromString(serialized));
+  EXPECT_EQ("db", request.params().at("service"));
+  bool found_source = false;
+  bool found_first_bytes = false;
+  for (const inject::Header& header : request.inputheaders()) {
+    if (header.key() == "source.address") {
+      EXPECT_EQ(read_callbacks_.connection_.remoteAddress().asString(), header.value());
+      found_source = true;
+    } else if (header.key() == "first_bytes") {
+      EXPECT_EQ("hell", header.value());
+      found_first_bytes = true;
+    }
+  }
+  EXPECT_TRUE(found_source);
+  EXPECT_TRUE(found_first_bytes);
+}
+
+TEST_F(NetworkInjectFilterTest, CloseCancelsRpc) {
+  setup(config_json_);
+  expectInjectRequestSent();
+  filter_->onNewConnection();
+  EXPECT_CALL(async_stream_, reset());
+  filter_->onEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_EQ(0U, fac_ctx_.scope_.gauge("network_inject.rpc_active").value());
+  EXPECT_EQ(NetworkInjectFilter::State::Closed, filter_->getState());
+}
+
+} // Filter
+} // Envoy
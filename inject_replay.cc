@@ -0,0 +1,422 @@
+// Replays a capture file written by the inject filter's "capture" mode
+// through a filter config. A stand-in injector answers every inject RPC
+// with its recorded response or failure after its recorded latency, and
+// requests are issued with their recorded spacing, so the filter sees
+// the captured concurrency and injector behaviour on one event loop.
+// Reports the latency the filter added on top of the injector's and the
+// CPU the filter (and its gRPC client) used per request.
+//
+// bazel run -c opt //:inject_replay -- <filter config json> <capture file> [speed]
+//
+// The config file holds the filter's "config" object. speed scales the
+// recorded request spacing (2 replays twice as fast; default 1).
+// Requests are rebuilt from the recorded inject request: its input
+// headers become request headers ("cookie.<name>" ones a cookie). RPCs
+// recorded as cancelled are skipped, as their downstream reset can't be
+// reproduced. The stand-in honours the config's timeout_ms. Timers have
+// millisecond resolution, so recorded latencies are rounded up to it.
+
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "inject_config.h"
+#include "common/common/thread.h"
+#include "common/event/dispatcher_impl.h"
+#include "common/grpc/common.h"
+#include "common/http/header_map_impl.h"
+#include "google/protobuf/io/coded_stream.h"
+
+#include "test/mocks/http/mocks.h"
+#include "test/mocks/server/mocks.h"
+
+namespace Envoy {
+namespace Http {
+
+using testing::InvokeWithoutArgs;
+using testing::NiceMock;
+using testing::ReturnRef;
+using testing::_;
+
+namespace {
+
+std::chrono::nanoseconds threadCpuTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+std::chrono::milliseconds roundUpMs(std::chrono::microseconds us) {
+  return std::chrono::milliseconds((us.count() + 999) / 1000);
+}
+
+std::vector<inject::InjectCaptureRecord> loadCapture(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw EnvoyException("cannot open capture file " + path);
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  const std::string data = contents.str();
+
+  std::vector<inject::InjectCaptureRecord> records;
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data());
+  const uint8_t* end = p + data.size();
+  while (p < end) {
+    google::protobuf::io::CodedInputStream in(p, end - p);
+    uint32_t size;
+    if (!in.ReadVarint32(&size) || size > static_cast<size_t>(end - p - in.CurrentPosition())) {
+      std::cerr << "capture file truncated after " << records.size() << " records\n";
+      break;
+    }
+    records.emplace_back();
+    if (!records.back().ParseFromArray(p + in.CurrentPosition(), size)) {
+      throw EnvoyException(fmt::format("bad capture record {} in {}", records.size(), path));
+    }
+    p += in.CurrentPosition() + size;
+  }
+  // records are written as RPCs complete
+  std::stable_sort(records.begin(), records.end(),
+                   [](const inject::InjectCaptureRecord& a, const inject::InjectCaptureRecord& b) {
+                     return a.start_time_us() < b.start_time_us();
+                   });
+  return records;
+}
+
+// the request a captured inject request came from, as far as it shows
+HeaderMapPtr replayHeaders(const inject::InjectRequest& request) {
+  HeaderMapPtr headers(new HeaderMapImpl());
+  std::string cookies;
+  for (const inject::Header& header : request.inputheaders()) {
+    if (header.key().compare(0, 7, "cookie.") == 0) {
+      cookies += (cookies.empty() ? "" : "; ") + header.key().substr(7) + "=" + header.value();
+    } else {
+      headers->addCopy(LowerCaseString(header.key()), header.value());
+    }
+  }
+  if (!cookies.empty()) {
+    headers->addCopy(LowerCaseString("cookie"), cookies);
+  }
+  if (!headers->Method()) {
+    headers->addCopy(Headers::get().Method, "GET");
+  }
+  if (!headers->Path()) {
+    headers->addCopy(Headers::get().Path, "/");
+  }
+  if (!headers->Host()) {
+    headers->addCopy(Headers::get().Host, "replay");
+  }
+  return headers;
+}
+
+struct LatencySummary {
+  std::chrono::microseconds p50_;
+  std::chrono::microseconds p99_;
+  std::chrono::microseconds p999_;
+};
+
+LatencySummary summarize(std::vector<std::chrono::microseconds> latencies) {
+  if (latencies.empty()) {
+    return {};
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto at = [&latencies](double q) {
+    size_t rank = std::max<size_t>(1, std::ceil(q * latencies.size()));
+    return latencies[rank - 1];
+  };
+  return {at(0.5), at(0.99), at(0.999)};
+}
+
+} // namespace
+
+class InjectReplay;
+
+// one replayed request and its filter
+struct ReplayRequest {
+  ReplayRequest(InjectReplay& replay, const inject::InjectCaptureRecord& record);
+
+  InjectReplay& replay_;
+  const inject::InjectCaptureRecord& record_;
+  HeaderMapPtr headers_;
+  NiceMock<MockStreamDecoderFilterCallbacks> decoder_callbacks_;
+  NiceMock<MockStreamEncoderFilterCallbacks> encoder_callbacks_;
+  std::unique_ptr<InjectFilter> filter_;
+  MonotonicTime start_;
+  std::chrono::microseconds injector_time_{};
+  bool done_{};
+};
+
+typedef std::unique_ptr<ReplayRequest> ReplayRequestPtr;
+
+// an inject RPC to the stand-in injector
+class StandInStream : public AsyncClient::Stream {
+public:
+  StandInStream(InjectReplay& replay, ReplayRequest& request, AsyncClient::StreamCallbacks& callbacks,
+                const Optional<std::chrono::milliseconds>& timeout);
+
+  // AsyncClient::Stream
+  void sendHeaders(HeaderMap&, bool) override {}
+  void sendData(Buffer::Instance&, bool) override {}
+  void sendTrailers(HeaderMap&) override {}
+  void reset() override;
+
+  std::list<std::unique_ptr<StandInStream>>::iterator self_;
+
+private:
+  void respond();
+  void finish();
+
+  InjectReplay& replay_;
+  ReplayRequest& request_;
+  AsyncClient::StreamCallbacks& callbacks_;
+  Event::TimerPtr timer_;
+  MonotonicTime start_;
+  bool timed_out_{};
+  bool finished_{};
+};
+
+// answers inject RPCs as recorded
+class StandInInjector : public AsyncClient {
+public:
+  StandInInjector(InjectReplay& replay) : replay_(replay) {}
+
+  // the request whose inject RPC is started next
+  void next(ReplayRequest* request) { next_ = request; }
+
+  // AsyncClient
+  Request* send(MessagePtr&&, Callbacks&, const Optional<std::chrono::milliseconds>&) override {
+    NOT_IMPLEMENTED;
+  }
+  Stream* start(StreamCallbacks& callbacks, const Optional<std::chrono::milliseconds>& timeout) override {
+    streams_.emplace_back(new StandInStream(replay_, *next_, callbacks, timeout));
+    streams_.back()->self_ = std::prev(streams_.end());
+    return streams_.back().get();
+  }
+
+  std::list<std::unique_ptr<StandInStream>> streams_;
+
+private:
+  InjectReplay& replay_;
+  ReplayRequest* next_{};
+};
+
+class InjectReplay {
+public:
+  InjectReplay(const Json::Object& config, std::vector<inject::InjectCaptureRecord>&& records, double speed)
+      : records_(std::move(records)), speed_(speed), injector_(*this) {
+    ON_CALL(fac_ctx_.cluster_manager_, httpAsyncClientForCluster(_)).WillByDefault(ReturnRef(injector_));
+    config_ = Server::Configuration::InjectFilterConfig::createConfig(config, "replay.", fac_ctx_);
+    arrival_timer_ = dispatcher_.createTimer([this]() -> void { issueDue(); });
+  }
+
+  void run() {
+    replay_start_ = std::chrono::steady_clock::now();
+    issueDue();
+    dispatcher_.run(Event::Dispatcher::RunType::Block);
+  }
+
+  void report() {
+    LatencySummary added = summarize(added_latencies_);
+    LatencySummary injector = summarize(injector_latencies_);
+    std::cout << fmt::format("{} requests replayed, {} cancelled RPCs skipped, {} max in flight\n", issued_,
+                             skipped_, max_active_)
+              << fmt::format("{} continued, {} answered locally\n", continued_, local_replies_)
+              << fmt::format("{:<30}{:>10}{:>10}{:>10}\n", "latency (us)", "p50", "p99", "p999")
+              << fmt::format("{:<30}{:>10}{:>10}{:>10}\n", "injector", injector.p50_.count(),
+                             injector.p99_.count(), injector.p999_.count())
+              << fmt::format("{:<30}{:>10}{:>10}{:>10}\n", "added by filter", added.p50_.count(),
+                             added.p99_.count(), added.p999_.count())
+              << fmt::format("filter CPU us/request: {:.2f}\n",
+                             issued_ ? filter_cpu_.count() / 1000.0 / issued_ : 0.0);
+  }
+
+  // the filter let the request continue or answered it itself
+  void complete(ReplayRequest& request, bool continued) {
+    if (request.done_) {
+      return;
+    }
+    request.done_ = true;
+    (continued ? continued_ : local_replies_)++;
+    std::chrono::microseconds latency =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - request.start_);
+    added_latencies_.push_back(latency - request.injector_time_);
+    injector_latencies_.push_back(request.injector_time_);
+    // the filter may be on the stack
+    ReplayRequest* done = &request;
+    dispatcher_.post([this, done]() -> void {
+      done->filter_->onDestroy();
+      active_.erase(done);
+    });
+  }
+
+  // run a filter callback, charging its CPU to the filter
+  template <class F> void timeFilter(F f) {
+    std::chrono::nanoseconds start = threadCpuTime();
+    f();
+    filter_cpu_ += threadCpuTime() - start;
+  }
+
+  Event::Dispatcher& dispatcher() { return dispatcher_; }
+  InjectFilterConfigSharedPtr config() { return config_; }
+  StandInInjector& injector() { return injector_; }
+
+private:
+  void issueDue() {
+    MonotonicTime now = std::chrono::steady_clock::now();
+    while (next_record_ < records_.size()) {
+      const inject::InjectCaptureRecord& record = records_[next_record_];
+      MonotonicTime due = replay_start_ + std::chrono::duration_cast<MonotonicTime::duration>(
+                                              std::chrono::microseconds(static_cast<int64_t>(
+                                                  (record.start_time_us() - records_[0].start_time_us()) / speed_)));
+      if (due > now) {
+        arrival_timer_->enableTimer(roundUpMs(std::chrono::duration_cast<std::chrono::microseconds>(due - now)));
+        return;
+      }
+      next_record_++;
+      if (record.result() == "local.cancelled") {
+        skipped_++;
+        continue;
+      }
+      issue(record);
+    }
+  }
+
+  void issue(const inject::InjectCaptureRecord& record) {
+    ReplayRequestPtr owned(new ReplayRequest(*this, record));
+    ReplayRequest& request = *owned;
+    active_[&request] = std::move(owned);
+    max_active_ = std::max<uint64_t>(max_active_, active_.size());
+    issued_++;
+
+    injector_.next(&request);
+    request.start_ = std::chrono::steady_clock::now();
+    FilterHeadersStatus status;
+    timeFilter([&request, &status]() -> void { status = request.filter_->decodeHeaders(*request.headers_, true); });
+    if (status == FilterHeadersStatus::Continue) {
+      complete(request, true);
+    }
+  }
+
+  NiceMock<Server::Configuration::MockFactoryContext> fac_ctx_;
+  Event::DispatcherImpl dispatcher_;
+  std::vector<inject::InjectCaptureRecord> records_;
+  const double speed_;
+  StandInInjector injector_;
+  InjectFilterConfigSharedPtr config_;
+  Event::TimerPtr arrival_timer_;
+  MonotonicTime replay_start_;
+  size_t next_record_{};
+  std::map<ReplayRequest*, ReplayRequestPtr> active_;
+
+  uint64_t issued_{};
+  uint64_t skipped_{};
+  uint64_t max_active_{};
+  uint64_t continued_{};
+  uint64_t local_replies_{};
+  std::chrono::nanoseconds filter_cpu_{};
+  std::vector<std::chrono::microseconds> added_latencies_;
+  std::vector<std::chrono::microseconds> injector_latencies_;
+};
+
+ReplayRequest::ReplayRequest(InjectReplay& replay, const inject::InjectCaptureRecord& record)
+    : replay_(replay), record_(record), headers_(replayHeaders(record.request())),
+      filter_(new InjectFilter(replay.config())) {
+  ON_CALL(decoder_callbacks_, continueDecoding()).WillByDefault(InvokeWithoutArgs([this]() -> void {
+    replay_.complete(*this, true);
+  }));
+  ON_CALL(decoder_callbacks_, encodeHeaders_(_, _)).WillByDefault(InvokeWithoutArgs([this]() -> void {
+    replay_.complete(*this, false);
+  }));
+  ON_CALL(decoder_callbacks_, dispatcher()).WillByDefault(ReturnRef(replay.dispatcher()));
+  filter_->setDecoderFilterCallbacks(decoder_callbacks_);
+  filter_->setEncoderFilterCallbacks(encoder_callbacks_);
+}
+
+StandInStream::StandInStream(InjectReplay& replay, ReplayRequest& request, AsyncClient::StreamCallbacks& callbacks,
+                             const Optional<std::chrono::milliseconds>& timeout)
+    : replay_(replay), request_(request), callbacks_(callbacks), start_(std::chrono::steady_clock::now()) {
+  std::chrono::milliseconds delay = roundUpMs(std::chrono::microseconds(request.record_.latency_us()));
+  if (timeout.valid() && delay > timeout.value()) {
+    delay = timeout.value();
+    timed_out_ = true;
+  }
+  timer_ = replay.dispatcher().createTimer([this]() -> void { respond(); });
+  timer_->enableTimer(delay);
+}
+
+void StandInStream::respond() {
+  request_.injector_time_ =
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_);
+  const inject::InjectCaptureRecord& record = request_.record_;
+  replay_.timeFilter([this, &record]() -> void {
+    if (!timed_out_ && record.grpc_status() == 0 && record.has_response()) {
+      callbacks_.onHeaders(HeaderMapPtr{new HeaderMapImpl{{Headers::get().Status, "200"},
+                                                          {Headers::get().ContentType, "application/grpc"}}},
+                           false);
+      callbacks_.onData(*Grpc::Common::serializeBody(record.response()), false);
+      callbacks_.onTrailers(HeaderMapPtr{new HeaderMapImpl{{Headers::get().GrpcStatus, "0"}}});
+    } else {
+      // trailers only
+      int status = timed_out_ ? Grpc::Status::GrpcStatus::DeadlineExceeded : record.grpc_status();
+      callbacks_.onHeaders(HeaderMapPtr{new HeaderMapImpl{{Headers::get().Status, "200"},
+                                                          {Headers::get().GrpcStatus, std::to_string(status)}}},
+                           true);
+    }
+  });
+  finish();
+}
+
+void StandInStream::reset() {
+  timer_->disableTimer();
+  finish();
+}
+
+void StandInStream::finish() {
+  if (finished_) {
+    return;
+  }
+  finished_ = true;
+  // the gRPC client may still be unwinding through this stream
+  StandInInjector& injector = replay_.injector();
+  auto self = self_;
+  replay_.dispatcher().post([&injector, self]() -> void { injector.streams_.erase(self); });
+}
+
+} // Http
+} // Envoy
+
+int main(int argc, char** argv) {
+  if (argc < 3 || argc > 4) {
+    std::cerr << "usage: " << argv[0] << " <filter config json> <capture file> [speed]\n";
+    return 1;
+  }
+  // the filter logs every trigger at info
+  Envoy::Thread::MutexBasicLockable lock;
+  Envoy::Logger::Registry::initialize(spdlog::level::err, lock);
+
+  try {
+    Envoy::Json::ObjectSharedPtr config = Envoy::Json::Factory::loadFromFile(argv[1]);
+    double speed = argc == 4 ? std::stod(argv[3]) : 1.0;
+    if (!(speed > 0)) {
+      std::cerr << "speed must be positive\n";
+      return 1;
+    }
+    Envoy::Http::InjectReplay replay(*config, Envoy::Http::loadCapture(argv[2]), speed);
+    replay.run();
+    replay.report();
+  } catch (const Envoy::EnvoyException& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
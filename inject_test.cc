@@ -3,14 +3,20 @@
 #include <vector>
 #include <iostream>
 
+#include "inject_admin.h"
 #include "inject_config.h"
 #include "common/buffer/buffer_impl.h"
 #include "common/common/empty_string.h"
 #include "common/http/filter/ratelimit.h"
 #include "common/http/headers.h"
 
+#include "google/protobuf/io/coded_stream.h"
+
+#include "test/mocks/filesystem/mocks.h"
 #include "test/mocks/server/mocks.h"
 #include "test/mocks/http/mocks.h"
+#include "test/mocks/tracing/mocks.h"
+#include "test/test_common/environment.h"
 #include "test/test_common/utility.h"
 
 #include "gmock/gmock.h"
@@ -22,6 +28,7 @@ using testing::Invoke;
 using testing::NiceMock;
 using testing::Return;
 using testing::ReturnRef;
+using testing::SaveArg;
 using testing::SetArgReferee;
 using testing::WithArgs;
 using testing::_;
@@ -32,7 +39,34 @@ class InjectFilterTest : public testing::Test {
 public:
   InjectFilterTest() {}
 
+  // make the next inject RPC send() succeed and stay outstanding
+  void expectInjectRequestSent() {
+    EXPECT_CALL(fac_ctx_.cluster_manager_.async_client_, start(_, _)).WillOnce(Return(&async_stream_));
+  }
+
+  // decodeData as the connection manager drives it: a chunk the filter
+  // buffers is added to the stream's decoding buffer, which the filter
+  // sees through decodingBuffer() on the next chunk
+  Http::FilterDataStatus decodeData(Http::InjectFilter& f, Buffer::Instance& data, bool end_stream) {
+    ON_CALL(mdcb_, decodingBuffer()).WillByDefault(Return(&decoding_buffer_));
+    Http::FilterDataStatus status = f.decodeData(data, end_stream);
+    if (status == Http::FilterDataStatus::StopIterationAndBuffer) {
+      decoding_buffer_.move(data);
+    }
+    return status;
+  }
+
+  std::unique_ptr<inject::InjectResponse> okResponse() {
+    std::unique_ptr<inject::InjectResponse> resp(new inject::InjectResponse());
+    resp->set_result("ok");
+    return resp;
+  }
+
   NiceMock<Server::Configuration::MockFactoryContext> fac_ctx_;
+  NiceMock<MockAsyncClientStream> async_stream_;
+  NiceMock<MockStreamDecoderFilterCallbacks> mdcb_;
+  NiceMock<MockStreamEncoderFilterCallbacks> mecb_;
+  Buffer::OwnedImpl decoding_buffer_;
 };
 
 TEST_F(InjectFilterTest, BadConfigNoCluster) {
@@ -299,6 +333,160 @@ TEST_F(InjectFilterTest, GoodConfigAlwaysTriggeredExplicitFalseWorks) {
   EXPECT_EQ(Http::InjectFilter::State::NotTriggered, f.getState());
 }
 
+TEST_F(InjectFilterTest, GoodTypedConfig) {
+  const std::string filter_config = R"EOF(
+  {
+    "typed_config": {
+      "trigger_headers": [{ "name": "x-session"}, { "name": "cookie.sessId"}],
+      "include_headers": [":path"],
+      "params": { "p1": "v1" },
+      "cluster_name": "sessionCheck",
+      "timeout_ms": 2222,
+      "buffer_overflow_action": "ABORT",
+      "stat_prefix": "typed",
+      "actions": [
+        {
+          "result": ["ok"],
+          "upstream_inject_headers": ["X-Myco-Jwt"],
+          "upstream_remove_headers": ["cookie.sessId"]
+        },
+        {
+          "result": ["deny"],
+          "action": "abort",
+          "response_code": 403,
+          "response_headers": [{ "key": "www-authenticate", "value": "Bearer" }]
+        }
+      ]
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigSharedPtr c = Server::Configuration::InjectFilterConfig::createConfig(*config, "http.", fac_ctx_);
+  EXPECT_EQ("sessionCheck", c->cluster_name());
+  EXPECT_EQ(2222, c->timeout_ms());
+  EXPECT_EQ(Http::InjectFilterConfig::BufferOverflowAction::Abort, c->buffer_overflow_action());
+  EXPECT_EQ("http.inject.typed.", c->stats_prefix());
+  ASSERT_EQ(1U, c->trigger_headers().size());
+  EXPECT_EQ("x-session", c->trigger_headers()[0].name_.get());
+  EXPECT_EQ((std::vector<std::string>{"sessId"}), c->trigger_cookie_names());
+  EXPECT_EQ("v1", c->params()["p1"]);
+  EXPECT_FALSE(c->always_triggered());
+
+  const Http::InjectAction& ok = c->action_matcher().match("ok");
+  EXPECT_EQ("passthrough", ok.action_);
+  ASSERT_EQ(1U, ok.upstream_inject_headers_.size());
+  EXPECT_EQ("x-myco-jwt", ok.upstream_inject_headers_[0].get());
+  EXPECT_EQ((std::vector<std::string>{"sessId"}), ok.upstream_remove_cookie_names_);
+  const Http::InjectAction& deny = c->action_matcher().match("deny");
+  EXPECT_EQ("abort", deny.action_);
+  EXPECT_EQ(403, deny.response_code_);
+  EXPECT_EQ((std::map<std::string, std::string>{{"www-authenticate", "Bearer"}}), deny.response_headers_);
+}
+
+TEST_F(InjectFilterTest, AbortResponseHeaders) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "actions": [
+      {
+        "result": ["deny"],
+        "action": "abort",
+        "response_code": 401,
+        "response_headers": [{ "key": "www-authenticate", "value": "Bearer" }],
+        "response_body": "login"
+      }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+
+  EXPECT_CALL(mdcb_, encodeHeaders_(_, false)).WillOnce(Invoke([](Http::HeaderMap& headers, bool) -> void {
+    EXPECT_STREQ("401", headers.Status()->value().c_str());
+    const Http::HeaderEntry* authenticate = headers.get(Http::LowerCaseString("www-authenticate"));
+    ASSERT_NE(nullptr, authenticate);
+    EXPECT_STREQ("Bearer", authenticate->value().c_str());
+  }));
+  std::unique_ptr<inject::InjectResponse> resp(new inject::InjectResponse());
+  resp->set_result("deny");
+  f.onSuccess(std::move(resp));
+}
+
+TEST_F(InjectFilterTest, GoodTypedConfigDefaults) {
+  const std::string filter_config = R"EOF(
+  {
+    "typed_config": {
+      "always_triggered": false,
+      "cluster_name": "sessionCheck",
+      "actions": [{ "result": ["deny"], "action": "abort" }]
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigSharedPtr c = Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_);
+  EXPECT_EQ(120, c->timeout_ms());
+  EXPECT_EQ(Http::InjectFilterConfig::BufferOverflowAction::Pause, c->buffer_overflow_action());
+  EXPECT_EQ(500, c->action_matcher().match("deny").response_code_);
+  EXPECT_EQ(nullptr, c->capture());
+  EXPECT_EQ(0, c->memo_ttl().count());
+}
+
+TEST_F(InjectFilterTest, TypedConfigHeaderMatchAndNumbers) {
+  const std::string filter_config = R"EOF(
+  {
+    "typed_config": {
+      "triggerHeaders": [{ "name": "x-session", "value": "^a[0-9]+$", "regex": true }],
+      "cluster_name": "sessionCheck",
+      "capture": { "path": "/tmp/inject.capture", "sample_percent": 50 },
+      "actions": [{ "result": ["ok"] }]
+    }
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigSharedPtr c = Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_);
+  ASSERT_EQ(1U, c->trigger_headers().size());
+  EXPECT_TRUE(c->trigger_headers()[0].is_regex_);
+  Http::TestHeaderMapImpl headers{{"x-session", "a123"}};
+  EXPECT_TRUE(Http::InjectFilter::matchHeader(headers, c->trigger_headers()[0]));
+  Http::TestHeaderMapImpl other_headers{{"x-session", "b123"}};
+  EXPECT_FALSE(Http::InjectFilter::matchHeader(other_headers, c->trigger_headers()[0]));
+  EXPECT_NE(nullptr, c->capture());
+
+  // numbers are JSON numbers
+  config = Json::Factory::loadFromString(
+      R"EOF({"typed_config": {"cluster_name": "sessionCheck", "always_triggered": true, "timeout_ms": "5"}})EOF");
+  EXPECT_THROW(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_), EnvoyException);
+}
+
+TEST_F(InjectFilterTest, BadTypedConfig) {
+  // unknown field
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(
+      R"EOF({"typed_config": {"cluster_name": "sessionCheck", "always_triggered": true, "timeout": 5}})EOF");
+  EXPECT_THROW(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_), EnvoyException);
+
+  // mixed with JSON fields
+  config = Json::Factory::loadFromString(
+      R"EOF({"typed_config": {"cluster_name": "sessionCheck", "always_triggered": true}, "timeout_ms": 5})EOF");
+  EXPECT_THROW(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_), EnvoyException);
+
+  // no triggers and always_triggered not given
+  config = Json::Factory::loadFromString(R"EOF({"typed_config": {"cluster_name": "sessionCheck"}})EOF");
+  EXPECT_THROW(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_), EnvoyException);
+
+  // no cluster
+  config = Json::Factory::loadFromString(R"EOF({"typed_config": {"always_triggered": true}})EOF");
+  EXPECT_THROW(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_), EnvoyException);
+}
+
 TEST_F(InjectFilterTest, BadConfigTriggers) {
   const std::string filter_config = R"EOF(
   {
@@ -647,6 +835,1123 @@ TEST_F(InjectFilterTest, ActionsBasic) {
 
 }
 
+TEST_F(InjectFilterTest, ConfigProviderSwapKeepsInFlightSnapshot) {
+  const std::string filter_config1 = R"EOF(
+  {
+    "trigger_headers": [{ "name": "cookie.sessId"}],
+    "cluster_name": "sessionCheck",
+    "timeout_ms": 100
+  }
+  )EOF";
+  const std::string filter_config2 = R"EOF(
+  {
+    "trigger_headers": [{ "name": "cookie.sessId"}],
+    "cluster_name": "sessionCheck",
+    "timeout_ms": 200
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config1 = Json::Factory::loadFromString(filter_config1);
+  Json::ObjectSharedPtr config2 = Json::Factory::loadFromString(filter_config2);
+  Http::InjectFilterConfigSharedPtr fconfig1 = Server::Configuration::InjectFilterConfig::createConfig(*config1, "", fac_ctx_);
+  std::weak_ptr<Http::InjectFilterConfig> old_snapshot(fconfig1);
+
+  Http::InjectFilterConfigProvider provider(fac_ctx_.thread_local_, fconfig1);
+  fconfig1.reset();
+  Http::InjectFilterConfigSharedPtr in_flight = provider.config();
+  EXPECT_EQ(100, in_flight->timeout_ms());
+
+  provider.update(Server::Configuration::InjectFilterConfig::createConfig(*config2, "", fac_ctx_));
+  EXPECT_EQ(200, provider.config()->timeout_ms());
+  EXPECT_EQ(100, in_flight->timeout_ms());
+  EXPECT_FALSE(old_snapshot.expired());
+
+  // reclaimed once the last in-flight user lets go
+  in_flight.reset();
+  EXPECT_TRUE(old_snapshot.expired());
+}
+
+TEST_F(InjectFilterTest, ConfigProviderRefcountIsPerWorker) {
+  const std::string filter_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "cookie.sessId"}],
+    "cluster_name": "sessionCheck"
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigSharedPtr fconfig = Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_);
+  std::weak_ptr<Http::InjectFilterConfig> snapshot(fconfig);
+  Http::InjectFilterConfigProvider provider(fac_ctx_.thread_local_, fconfig);
+  fconfig.reset();
+
+  // filters taking the config don't touch the snapshot's own count
+  long shared_refs = snapshot.use_count();
+  Http::InjectFilterConfigSharedPtr filter1_config = provider.config();
+  Http::InjectFilterConfigSharedPtr filter2_config = provider.config();
+  EXPECT_EQ(shared_refs, snapshot.use_count());
+  EXPECT_EQ(snapshot.lock().get(), filter1_config.get());
+}
+
+TEST_F(InjectFilterTest, ConfigReloaderSwapsOnGoodFileOnly) {
+  const std::string filter_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "cookie.sessId"}],
+    "cluster_name": "sessionCheck",
+    "timeout_ms": 100
+  }
+  )EOF";
+  const std::string reloaded_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "cookie.sessId"}],
+    "cluster_name": "sessionCheck",
+    "timeout_ms": 300
+  }
+  )EOF";
+
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigProviderSharedPtr provider(new Http::InjectFilterConfigProvider(
+      fac_ctx_.thread_local_, Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_)));
+
+  const std::string path = TestEnvironment::temporaryPath("inject_reload.json");
+  Filesystem::MockWatcher* watcher = new NiceMock<Filesystem::MockWatcher>();
+  EXPECT_CALL(fac_ctx_.dispatcher_, createFilesystemWatcher_()).WillOnce(Return(watcher));
+  EXPECT_CALL(*watcher, addWatch(path, Filesystem::Watcher::Events::MovedTo, _));
+  Server::Configuration::InjectConfigReloader reloader(path, "", provider, fac_ctx_);
+
+  TestEnvironment::writeStringToFileForTest("inject_reload.json", "{ \"cluster_name\": 7 }");
+  EXPECT_FALSE(reloader.reload());
+  EXPECT_EQ(100, provider->config()->timeout_ms());
+
+  TestEnvironment::writeStringToFileForTest("inject_reload.json", reloaded_config);
+  EXPECT_TRUE(reloader.reload());
+  EXPECT_EQ(300, provider->config()->timeout_ms());
+}
+
+TEST_F(InjectFilterTest, BufferLimitPausesDownstreamReads) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "max_buffer_bytes": 10,
+    "actions": [
+      {
+        "result": ["ok"],
+        "action": "passthrough"
+      }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "POST"}, {":path", "/upload"},
+                                  {":scheme", "http"}, {":authority", "host"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, false));
+  EXPECT_EQ(Http::InjectFilter::State::InjectRequestSent, f.getState());
+
+  Buffer::OwnedImpl small("12345");
+  EXPECT_CALL(mdcb_, onDecoderFilterAboveWriteBufferHighWatermark()).Times(0);
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, decodeData(f, small, false));
+
+  // only pauses once however much more arrives
+  Buffer::OwnedImpl big(std::string(20, 'a'));
+  Buffer::OwnedImpl big2(std::string(20, 'b'));
+  EXPECT_CALL(mdcb_, onDecoderFilterAboveWriteBufferHighWatermark()).Times(1);
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, decodeData(f, big, false));
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, decodeData(f, big2, false));
+  EXPECT_EQ(45U, decoding_buffer_.length());
+
+  EXPECT_CALL(mdcb_, onDecoderFilterBelowWriteBufferLowWatermark());
+  EXPECT_CALL(mdcb_, continueDecoding());
+  f.onSuccess(okResponse());
+  EXPECT_EQ(Http::InjectFilter::State::WaitingForUpstream, f.getState());
+}
+
+TEST_F(InjectFilterTest, BufferLimitAbort) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "max_buffer_bytes": 10,
+    "buffer_overflow_action": "abort",
+    "actions": [
+      {
+        "result": ["local.error"],
+        "downstream_remove_headers": ["x-removed"]
+      }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "POST"}, {":path", "/upload"},
+                                  {":scheme", "http"}, {":authority", "host"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, false));
+
+  // the local reply goes back through this filter's encodeHeaders, as
+  // the connection manager would send it, before any action is chosen
+  Http::TestHeaderMapImpl response_headers{{":status", "413"}};
+  EXPECT_CALL(async_stream_, reset());
+  EXPECT_CALL(mdcb_, encodeHeaders_(HeaderMapEqualRef(&response_headers), _))
+      .WillOnce(Invoke([&](Http::HeaderMap& reply_headers, bool end_stream) -> void {
+        EXPECT_EQ(Http::FilterHeadersStatus::Continue, f.encodeHeaders(reply_headers, end_stream));
+      }));
+  Buffer::OwnedImpl big(std::string(20, 'a'));
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer, decodeData(f, big, false));
+  EXPECT_EQ(Http::InjectFilter::State::Aborting, f.getState());
+}
+
+TEST_F(InjectFilterTest, BufferLimitCountsBufferedChunks) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "max_buffer_bytes": 10,
+    "buffer_overflow_action": "abort"
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "POST"}, {":path", "/upload"},
+                                  {":scheme", "http"}, {":authority", "host"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, false));
+
+  // no chunk is over the limit on its own; the third takes the total
+  // buffered past it
+  Buffer::OwnedImpl chunk1("1234");
+  Buffer::OwnedImpl chunk2("5678");
+  Buffer::OwnedImpl chunk3("9012");
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, decodeData(f, chunk1, false));
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationAndBuffer, decodeData(f, chunk2, false));
+  EXPECT_EQ(8U, decoding_buffer_.length());
+  EXPECT_EQ(Http::InjectFilter::State::InjectRequestSent, f.getState());
+
+  EXPECT_CALL(async_stream_, reset());
+  EXPECT_CALL(mdcb_, encodeHeaders_(_, _));
+  EXPECT_EQ(Http::FilterDataStatus::StopIterationNoBuffer, decodeData(f, chunk3, false));
+  EXPECT_EQ(Http::InjectFilter::State::Aborting, f.getState());
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("inject.buffer_overflow").value());
+}
+
+TEST_F(InjectFilterTest, BufferLimitErrorActionStreamsThrough) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "max_buffer_bytes": 10,
+    "buffer_overflow_action": "error_action",
+    "actions": [
+      {
+        "result": ["local.error"],
+        "action": "passthrough"
+      }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "POST"}, {":path", "/upload"},
+                                  {":scheme", "http"}, {":authority", "host"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, false));
+
+  EXPECT_CALL(async_stream_, reset());
+  EXPECT_CALL(mdcb_, continueDecoding()).Times(0); // resumed by returning Continue
+  Buffer::OwnedImpl big(std::string(20, 'a'));
+  EXPECT_EQ(Http::FilterDataStatus::Continue, decodeData(f, big, false));
+  EXPECT_EQ(Http::InjectFilter::State::WaitingForUpstream, f.getState());
+}
+
+TEST_F(InjectFilterTest, SpeculativeConnectOnColdCluster) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "speculative_connect": true
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigProviderSharedPtr provider(new Http::InjectFilterConfigProvider(
+      fac_ctx_.thread_local_, Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_)));
+  Http::InjectFilter f(provider->config(), provider->workerState());
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+
+  ConnectionPool::MockCancellable pending;
+  EXPECT_CALL(fac_ctx_.cluster_manager_, httpConnPoolForCluster("fake_cluster", _, _));
+  EXPECT_CALL(fac_ctx_.cluster_manager_.conn_pool_, newStream(_, _)).WillOnce(Return(&pending));
+  EXPECT_CALL(pending, cancel());
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"},
+                                  {":scheme", "http"}, {":authority", "host"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+  f.onDestroy();
+}
+
+TEST_F(InjectFilterTest, SpeculativeConnectKeepsReadyConnection) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "speculative_connect": true
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigProviderSharedPtr provider(new Http::InjectFilterConfigProvider(
+      fac_ctx_.thread_local_, Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_)));
+  Http::InjectFilter f(provider->config(), provider->workerState());
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+
+  // the pool hands over a ready connection at once: it must stay open
+  // for the router
+  Http::MockStreamEncoder encoder;
+  EXPECT_CALL(encoder.stream_, resetStream(_)).Times(0);
+  EXPECT_CALL(fac_ctx_.cluster_manager_.conn_pool_, newStream(_, _))
+      .WillOnce(Invoke([&](Http::StreamDecoder&,
+                           ConnectionPool::Callbacks& callbacks) -> ConnectionPool::Cancellable* {
+        callbacks.onPoolReady(encoder, fac_ctx_.cluster_manager_.conn_pool_.host_);
+        return nullptr;
+      }));
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"},
+                                  {":scheme", "http"}, {":authority", "host"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+  f.onDestroy();
+}
+
+TEST_F(InjectFilterTest, SpeculativeConnectSkippedWhenClusterHasConnection) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "speculative_connect": true
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigProviderSharedPtr provider(new Http::InjectFilterConfigProvider(
+      fac_ctx_.thread_local_, Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_)));
+  Http::InjectFilter f(provider->config(), provider->workerState());
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+
+  // a connection open or opening in any worker's pool
+  fac_ctx_.cluster_manager_.thread_local_cluster_.cluster_.info_->stats().upstream_cx_active_.set(1);
+  EXPECT_CALL(fac_ctx_.cluster_manager_.conn_pool_, newStream(_, _)).Times(0);
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"},
+                                  {":scheme", "http"}, {":authority", "host"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+  f.onDestroy();
+}
+
+TEST_F(InjectFilterTest, RedoRoutingWhenRouteHeaderInjected) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "route_headers": ["x-tenant"],
+    "actions": [
+      {
+        "result": ["ok"],
+        "action": "passthrough",
+        "upstream_inject_headers": ["x-tenant"],
+        "redo_routing": true
+      }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"},
+                                  {":scheme", "http"}, {":authority", "host"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+
+  std::unique_ptr<inject::InjectResponse> resp = okResponse();
+  inject::Header* ih = resp->mutable_upstreamheaders()->Add();
+  ih->set_key("x-tenant");
+  ih->set_value("acme");
+  InSequence s;
+  EXPECT_CALL(mdcb_, clearRouteCache());
+  EXPECT_CALL(mdcb_, continueDecoding());
+  f.onSuccess(std::move(resp));
+  EXPECT_STREQ("acme", headers.get_("x-tenant").c_str());
+}
+
+TEST_F(InjectFilterTest, RedoRoutingSkippedForNonRouteHeader) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "route_headers": ["x-tenant"],
+    "actions": [
+      {
+        "result": ["ok"],
+        "action": "passthrough",
+        "upstream_inject_headers": ["x-myco-jwt"],
+        "redo_routing": true
+      }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"},
+                                  {":scheme", "http"}, {":authority", "host"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+
+  std::unique_ptr<inject::InjectResponse> resp = okResponse();
+  inject::Header* ih = resp->mutable_upstreamheaders()->Add();
+  ih->set_key("x-myco-jwt");
+  ih->set_value("(a-signed-jwt)");
+  EXPECT_CALL(mdcb_, clearRouteCache()).Times(0);
+  EXPECT_CALL(mdcb_, continueDecoding());
+  f.onSuccess(std::move(resp));
+}
+
+TEST_F(InjectFilterTest, InjectedValuesReferencedNotCopied) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "actions": [
+      {
+        "result": ["ok"],
+        "action": "passthrough",
+        "upstream_inject_headers": ["x-myco-jwt"],
+        "downstream_inject_any": true
+      }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"},
+                                  {":scheme", "http"}, {":authority", "host"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+
+  // realistically sized signed token
+  const std::string jwt(3 * 1024, 'j');
+  std::unique_ptr<inject::InjectResponse> resp = okResponse();
+  inject::Header* ih = resp->mutable_upstreamheaders()->Add();
+  ih->set_key("x-myco-jwt");
+  ih->set_value(jwt);
+  ih = resp->mutable_downstreamheaders()->Add();
+  ih->set_key("X-Session-Token");
+  ih->set_value(jwt);
+  const inject::InjectResponse* raw_resp = resp.get();
+  f.onSuccess(std::move(resp));
+
+  const Http::HeaderEntry* up = headers.get(Http::LowerCaseString("x-myco-jwt"));
+  ASSERT_NE(nullptr, up);
+  EXPECT_EQ(jwt, up->value().c_str());
+  EXPECT_EQ(raw_resp->upstreamheaders(0).value().c_str(), up->value().c_str());
+
+  Http::TestHeaderMapImpl response_headers{{":status", "200"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, f.encodeHeaders(response_headers, false));
+  const Http::HeaderEntry* down = response_headers.get(Http::LowerCaseString("x-session-token"));
+  ASSERT_NE(nullptr, down);
+  EXPECT_EQ(raw_resp->downstreamheaders(0).value().c_str(), down->value().c_str());
+}
+
+TEST_F(InjectFilterTest, StatsForTriggeredRequest) {
+  const std::string filter_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "x-da-trigger"}],
+    "antitrigger_headers": [{ "name": "x-skip"}],
+    "cluster_name": "sessionCheck",
+    "actions": [
+      {
+        "result": ["ok"],
+        "action": "passthrough"
+      }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigSharedPtr fconfig = Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_);
+
+  Http::InjectFilter f(fconfig);
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"},
+                                  {":scheme", "http"}, {":authority", "host"},
+                                  {"x-da-trigger", "1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.triggered").value());
+  EXPECT_EQ(1U, fac_ctx_.scope_.gauge("test.inject.rpc_active").value());
+  EXPECT_LT(0U, fac_ctx_.scope_.counter("test.inject.rpc_bytes_sent").value());
+
+  f.onSuccess(okResponse());
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.rpc_success").value());
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.result.ok").value());
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.action_passthrough").value());
+  EXPECT_EQ(0U, fac_ctx_.scope_.gauge("test.inject.rpc_active").value());
+
+  Http::InjectFilter f2(fconfig);
+  Http::TestHeaderMapImpl untriggered{{":method", "GET"}, {":path", "/"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, f2.decodeHeaders(untriggered, true));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.not_triggered").value());
+
+  Http::InjectFilter f3(fconfig);
+  Http::TestHeaderMapImpl antitriggered{{":method", "GET"}, {":path", "/"},
+                                        {"x-da-trigger", "1"}, {"x-skip", "1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, f3.decodeHeaders(antitriggered, true));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.antitriggered").value());
+}
+
+TEST_F(InjectFilterTest, StatsForCancelledRpc) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "stat_prefix": "sess"
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+  EXPECT_EQ(1U, fac_ctx_.scope_.gauge("test.inject.sess.rpc_active").value());
+  f.onDestroy();
+  EXPECT_EQ(0U, fac_ctx_.scope_.gauge("test.inject.sess.rpc_active").value());
+}
+
+TEST_F(InjectFilterTest, TracingSpanAroundInjectRpc) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "timeout_ms": 50,
+    "actions": [
+      {
+        "result": ["ok"],
+        "action": "passthrough"
+      }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+
+  Tracing::MockSpan* span = new NiceMock<Tracing::MockSpan>();
+  EXPECT_CALL(mdcb_.active_span_, spawnChild_(_, "InjectHeaders", _)).WillOnce(Return(span));
+  EXPECT_CALL(*span, setTag(Tracing::Tags::get().UPSTREAM_CLUSTER, "sessionCheck"));
+  EXPECT_CALL(*span, setTag("inject.timeout_ms", "50"));
+  EXPECT_CALL(*span, injectContext(_));
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+
+  EXPECT_CALL(*span, setTag("inject.result", "ok"));
+  EXPECT_CALL(*span, setTag("inject.action", "passthrough"));
+  EXPECT_CALL(*span, finishSpan(_));
+  EXPECT_CALL(mdcb_, continueDecoding());
+  f.onSuccess(okResponse());
+}
+
+TEST_F(InjectFilterTest, TracingSpanOnInjectRpcFailure) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck"
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+
+  Tracing::MockSpan* span = new NiceMock<Tracing::MockSpan>();
+  EXPECT_CALL(mdcb_.active_span_, spawnChild_(_, "InjectHeaders", _)).WillOnce(Return(span));
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+
+  EXPECT_CALL(*span, setTag(Tracing::Tags::get().ERROR, Tracing::Tags::get().TRUE));
+  EXPECT_CALL(*span, setTag("inject.grpc_status", std::to_string(Grpc::Status::GrpcStatus::Unavailable)));
+  EXPECT_CALL(*span, finishSpan(_));
+  f.onFailure(Grpc::Status::GrpcStatus::Unavailable, "");
+}
+
+TEST_F(InjectFilterTest, LatencyHistogramQuantiles) {
+  Http::InjectLatencyHistogram histogram;
+  Http::InjectLatencyHistogram::Counts counts{};
+  EXPECT_EQ(0U, Http::InjectLatencyHistogram::quantile(counts, 0.5));
+
+  for (int i = 0; i < 98; i++) {
+    histogram.record(std::chrono::microseconds(100));
+  }
+  histogram.record(std::chrono::microseconds(3000));
+  histogram.record(std::chrono::seconds(100));
+  histogram.addTo(counts);
+  EXPECT_EQ(128U, Http::InjectLatencyHistogram::quantile(counts, 0.5));
+  EXPECT_EQ(4096U, Http::InjectLatencyHistogram::quantile(counts, 0.99));
+  EXPECT_EQ(1U << 24, Http::InjectLatencyHistogram::quantile(counts, 0.999));
+}
+
+TEST_F(InjectFilterTest, AdminDumpShowsLiveState) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "timeout_ms": 75,
+    "actions": [
+      {
+        "result": ["ok", "fine"],
+        "action": "passthrough",
+        "upstream_inject_headers": ["x-user"]
+      }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigProviderSharedPtr provider(new Http::InjectFilterConfigProvider(
+      fac_ctx_.thread_local_, Server::Configuration::InjectFilterConfig::createConfig(*config, "http.test.", fac_ctx_)));
+  EXPECT_CALL(fac_ctx_.admin_, addHandler("/inject", _, _));
+  Server::InjectAdmin::add(fac_ctx_.admin_, provider);
+
+  Http::InjectFilter f(provider->config(), provider->workerState());
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+
+  Buffer::OwnedImpl response;
+  EXPECT_EQ(Http::Code::OK, Server::InjectAdmin::handler("/inject", response));
+  Json::ObjectSharedPtr dump = Json::Factory::loadFromString(TestUtility::bufferToString(response));
+  std::vector<Json::ObjectSharedPtr> filters = dump->getObjectArray("filters");
+  ASSERT_EQ(1U, filters.size());
+  EXPECT_EQ("http.test.inject", filters[0]->getString("name"));
+  EXPECT_EQ("sessionCheck", filters[0]->getString("cluster"));
+  EXPECT_EQ(75, filters[0]->getInteger("timeout_ms"));
+  EXPECT_EQ(1, filters[0]->getInteger("rpc_active"));
+  EXPECT_EQ("closed", filters[0]->getObject("circuit")->getString("connections"));
+  std::vector<Json::ObjectSharedPtr> actions = filters[0]->getObjectArray("actions");
+  ASSERT_EQ(2U, actions.size());
+  EXPECT_EQ("abort", actions[0]->getString("action"));
+  EXPECT_EQ(500, actions[0]->getInteger("response_code"));
+  EXPECT_EQ((std::vector<std::string>{"ok", "fine"}), actions[1]->getStringArray("result"));
+  EXPECT_EQ((std::vector<std::string>{"x-user"}), actions[1]->getStringArray("upstream_inject_headers"));
+
+  f.onSuccess(okResponse());
+  Buffer::OwnedImpl response2;
+  Server::InjectAdmin::handler("/inject", response2);
+  dump = Json::Factory::loadFromString(TestUtility::bufferToString(response2));
+  EXPECT_EQ(0, dump->getObjectArray("filters")[0]->getInteger("rpc_active"));
+
+  // dropped from the dump with the filter chain
+  provider.reset();
+  Buffer::OwnedImpl response3;
+  Server::InjectAdmin::handler("/inject", response3);
+  dump = Json::Factory::loadFromString(TestUtility::bufferToString(response3));
+  EXPECT_TRUE(dump->getObjectArray("filters").empty());
+
+  // the handler is still registered for a new filter chain
+  EXPECT_CALL(fac_ctx_.admin_, addHandler(_, _, _)).Times(0);
+  Http::InjectFilterConfigProviderSharedPtr provider2(new Http::InjectFilterConfigProvider(
+      fac_ctx_.thread_local_, Server::Configuration::InjectFilterConfig::createConfig(*config, "http.test.", fac_ctx_)));
+  Server::InjectAdmin::add(fac_ctx_.admin_, provider2);
+  Buffer::OwnedImpl response4;
+  Server::InjectAdmin::handler("/inject", response4);
+  dump = Json::Factory::loadFromString(TestUtility::bufferToString(response4));
+  EXPECT_EQ(1U, dump->getObjectArray("filters").size());
+}
+
+TEST_F(InjectFilterTest, FindCookieValue) {
+  Http::TestHeaderMapImpl headers{{"cookie", "geo=x; sessionId=939133-x9393;dnt=\"a314\""},
+                                  {"cookie", "empty=; other=sessionId=1"}};
+  const char* value;
+  size_t length;
+  EXPECT_TRUE(InjectFilter::findCookieValue(headers, "sessionId", value, length));
+  EXPECT_EQ("939133-x9393", std::string(value, length));
+  EXPECT_TRUE(InjectFilter::findCookieValue(headers, "dnt", value, length));
+  EXPECT_EQ("a314", std::string(value, length));
+  EXPECT_TRUE(InjectFilter::findCookieValue(headers, "empty", value, length));
+  EXPECT_EQ(0U, length);
+  EXPECT_TRUE(InjectFilter::findCookieValue(headers, "other", value, length));
+  EXPECT_EQ("sessionId=1", std::string(value, length));
+  EXPECT_FALSE(InjectFilter::findCookieValue(headers, "sessionid", value, length));
+  EXPECT_FALSE(InjectFilter::findCookieValue(headers, "geo=x", value, length));
+  EXPECT_FALSE(InjectFilter::findCookieValue(Http::TestHeaderMapImpl{}, "geo", value, length));
+}
+
+TEST_F(InjectFilterTest, CaptureWritesSampledRpc) {
+  const std::string filter_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "x-da-trigger"}],
+    "cluster_name": "sessionCheck",
+    "capture": { "path": "/tmp/inject.capture", "sample_percent": 50 },
+    "actions": [
+      {
+        "result": ["ok"],
+        "action": "passthrough"
+      }
+    ]
+  }
+  )EOF";
+  EXPECT_CALL(fac_ctx_.access_log_manager_, createAccessLog("/tmp/inject.capture"));
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigSharedPtr fconfig = Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_);
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}, {"x-da-trigger", "1"}};
+
+  // not sampled
+  EXPECT_CALL(fac_ctx_.random_, random()).WillOnce(Return(500000));
+  EXPECT_CALL(*fac_ctx_.access_log_manager_.file_, write(_)).Times(0);
+  Http::InjectFilter f(fconfig);
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+  f.onSuccess(okResponse());
+  EXPECT_EQ(0U, fac_ctx_.scope_.counter("test.inject.capture_records").value());
+
+  // sampled
+  std::string written;
+  EXPECT_CALL(fac_ctx_.random_, random()).WillOnce(Return(1499999));
+  EXPECT_CALL(*fac_ctx_.access_log_manager_.file_, write(_)).WillOnce(SaveArg<0>(&written));
+  Http::InjectFilter f2(fconfig);
+  f2.setDecoderFilterCallbacks(mdcb_);
+  f2.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f2.decodeHeaders(headers, true));
+  f2.onSuccess(okResponse());
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.capture_records").value());
+
+  google::protobuf::io::CodedInputStream in(reinterpret_cast<const uint8_t*>(written.data()), written.size());
+  uint32_t size;
+  ASSERT_TRUE(in.ReadVarint32(&size));
+  EXPECT_EQ(written.size() - in.CurrentPosition(), size);
+  inject::InjectCaptureRecord record;
+  ASSERT_TRUE(record.ParseFromCodedStream(&in));
+  EXPECT_EQ("ok", record.result());
+  EXPECT_EQ("ok", record.response().result());
+  EXPECT_EQ(0, record.grpc_status());
+  EXPECT_LT(0, record.start_time_us());
+  ASSERT_EQ(1, record.request().inputheaders_size());
+  EXPECT_EQ("x-da-trigger", record.request().inputheaders(0).key());
+}
+
+TEST_F(InjectFilterTest, CaptureStopsAtMaxBytes) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "capture": { "path": "/tmp/inject.capture", "max_bytes": 1 }
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  EXPECT_CALL(*fac_ctx_.access_log_manager_.file_, write(_)).Times(0);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+  f.onDestroy();
+  EXPECT_EQ(0U, fac_ctx_.scope_.counter("test.inject.capture_records").value());
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.capture_dropped").value());
+}
+
+// a reloaded config capturing to the same file counts what the config
+// it replaced already wrote
+TEST_F(InjectFilterTest, CaptureBoundSurvivesReload) {
+  const std::string filter_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "timeout_ms": 100,
+    "capture": { "path": "/tmp/inject.capture", "max_bytes": 8 }
+  }
+  )EOF";
+  const std::string reloaded_config = R"EOF(
+  {
+    "always_triggered": true,
+    "cluster_name": "sessionCheck",
+    "timeout_ms": 300,
+    "capture": { "path": "/tmp/inject.capture", "max_bytes": 8 }
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigProviderSharedPtr provider(new Http::InjectFilterConfigProvider(
+      fac_ctx_.thread_local_, Server::Configuration::InjectFilterConfig::createConfig(*config, "", fac_ctx_)));
+
+  const std::string path = TestEnvironment::temporaryPath("inject_capture_reload.json");
+  Filesystem::MockWatcher* watcher = new NiceMock<Filesystem::MockWatcher>();
+  EXPECT_CALL(fac_ctx_.dispatcher_, createFilesystemWatcher_()).WillOnce(Return(watcher));
+  Server::Configuration::InjectConfigReloader reloader(path, "", provider, fac_ctx_);
+
+  // 5 bytes framed
+  inject::InjectCaptureRecord record;
+  record.set_result("ok");
+  EXPECT_CALL(*fac_ctx_.access_log_manager_.file_, write(_));
+  EXPECT_TRUE(provider->config()->capture()->write(record));
+
+  TestEnvironment::writeStringToFileForTest("inject_capture_reload.json", reloaded_config);
+  EXPECT_TRUE(reloader.reload());
+  EXPECT_EQ(300, provider->config()->timeout_ms());
+  EXPECT_FALSE(provider->config()->capture()->write(record));
+}
+
+TEST_F(InjectFilterTest, ConnectionMemoReusesResponse) {
+  const std::string filter_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "x-da-trigger"}],
+    "cluster_name": "sessionCheck",
+    "connection_memo": { "ttl_ms": 60000 },
+    "actions": [
+      {
+        "result": ["ok"],
+        "action": "passthrough",
+        "upstream_inject_headers": ["x-user"]
+      }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigProviderSharedPtr provider(new Http::InjectFilterConfigProvider(
+      fac_ctx_.thread_local_, Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_)));
+  std::unique_ptr<inject::InjectResponse> resp = okResponse();
+  inject::Header* user = resp->add_upstreamheaders();
+  user->set_key("x-user");
+  user->set_value("alice");
+
+  Http::InjectFilter f(provider->config(), provider->workerState());
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}, {"x-da-trigger", "1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+  f.onSuccess(std::move(resp));
+  EXPECT_EQ("alice", headers.get_("x-user"));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.memo_miss").value());
+
+  // same connection and trigger value: no RPC
+  Http::InjectFilter f2(provider->config(), provider->workerState());
+  f2.setDecoderFilterCallbacks(mdcb_);
+  f2.setEncoderFilterCallbacks(mecb_);
+  EXPECT_CALL(fac_ctx_.cluster_manager_.async_client_, start(_, _)).Times(0);
+  EXPECT_CALL(mdcb_.active_span_, setTag("inject.cache", "hit"));
+  Http::TestHeaderMapImpl headers2{{":method", "GET"}, {":path", "/other"}, {"x-da-trigger", "1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, f2.decodeHeaders(headers2, true));
+  EXPECT_EQ("alice", headers2.get_("x-user"));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.memo_hit").value());
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.rpc_success").value());
+  testing::Mock::VerifyAndClearExpectations(&fac_ctx_.cluster_manager_.async_client_);
+
+  // a different trigger value misses
+  Http::InjectFilter f3(provider->config(), provider->workerState());
+  f3.setDecoderFilterCallbacks(mdcb_);
+  f3.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers3{{":method", "GET"}, {":path", "/"}, {"x-da-trigger", "2"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f3.decodeHeaders(headers3, true));
+  EXPECT_EQ(2U, fac_ctx_.scope_.counter("test.inject.memo_miss").value());
+  f3.onDestroy();
+
+  // the remembered response goes with its connection
+  EXPECT_EQ(1U, provider->workerState()->memo_.size());
+  mdcb_.connection_.raiseEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_EQ(0U, provider->workerState()->memo_.size());
+}
+
+// a response remembered for one route config is not used by another
+// on the same connection
+TEST_F(InjectFilterTest, ConnectionMemoKeptPerRouteConfig) {
+  const std::string filter_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "x-da-trigger"}],
+    "cluster_name": "sessionCheck",
+    "connection_memo": { "ttl_ms": 60000 },
+    "actions": [{ "result": ["ok"], "action": "passthrough" }],
+    "route_configs": {
+      "strict": {
+        "cluster_name": "sessionCheck",
+        "actions": [{ "result": ["ok"], "action": "passthrough" }]
+      }
+    }
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigProviderSharedPtr provider(new Http::InjectFilterConfigProvider(
+      fac_ctx_.thread_local_, Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_)));
+  std::multimap<std::string, std::string> no_opaque_config;
+  std::multimap<std::string, std::string> strict_opaque_config{{"inject.config", "strict"}};
+
+  // the base config and then the route config each send their own RPC
+  for (std::multimap<std::string, std::string>* opaque_config : {&no_opaque_config, &strict_opaque_config}) {
+    ON_CALL(mdcb_.route_->route_entry_, opaqueConfig()).WillByDefault(ReturnRef(*opaque_config));
+    Http::InjectFilter f(provider->config(), provider->workerState());
+    f.setDecoderFilterCallbacks(mdcb_);
+    f.setEncoderFilterCallbacks(mecb_);
+    expectInjectRequestSent();
+    Http::TestHeaderMapImpl request_headers{{":method", "GET"}, {":path", "/"}, {"x-da-trigger", "1"}};
+    EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(request_headers, true));
+    f.onSuccess(okResponse());
+    testing::Mock::VerifyAndClearExpectations(&fac_ctx_.cluster_manager_.async_client_);
+  }
+  EXPECT_EQ(2U, fac_ctx_.scope_.counter("test.inject.memo_miss").value());
+  EXPECT_EQ(2U, fac_ctx_.scope_.counter("test.inject.rpc_success").value());
+
+  // and each then finds its own
+  for (std::multimap<std::string, std::string>* opaque_config : {&no_opaque_config, &strict_opaque_config}) {
+    ON_CALL(mdcb_.route_->route_entry_, opaqueConfig()).WillByDefault(ReturnRef(*opaque_config));
+    Http::InjectFilter f(provider->config(), provider->workerState());
+    f.setDecoderFilterCallbacks(mdcb_);
+    f.setEncoderFilterCallbacks(mecb_);
+    EXPECT_CALL(fac_ctx_.cluster_manager_.async_client_, start(_, _)).Times(0);
+    Http::TestHeaderMapImpl request_headers{{":method", "GET"}, {":path", "/"}, {"x-da-trigger", "1"}};
+    EXPECT_EQ(Http::FilterHeadersStatus::Continue, f.decodeHeaders(request_headers, true));
+    testing::Mock::VerifyAndClearExpectations(&fac_ctx_.cluster_manager_.async_client_);
+  }
+  EXPECT_EQ(2U, fac_ctx_.scope_.counter("test.inject.memo_hit").value());
+}
+
+TEST_F(InjectFilterTest, ConnectionMemoExpiresAndStaysBounded) {
+  Http::InjectConnectionMemo memo;
+  Http::InjectResponseConstSharedPtr response(okResponse());
+  MonotonicTime now = std::chrono::steady_clock::now();
+  const std::chrono::milliseconds ttl = std::chrono::hours(1);
+  EXPECT_TRUE(memo.insert(1, "a", response, now, ttl, 2));
+  EXPECT_EQ(response, memo.lookup(1, "a", now));
+  EXPECT_EQ(nullptr, memo.lookup(2, "a", now));
+  EXPECT_EQ(nullptr, memo.lookup(1, "a", now + std::chrono::hours(2)));
+  EXPECT_EQ(0U, memo.size());
+
+  // the connection is already watched
+  EXPECT_FALSE(memo.insert(1, "a", response, now, ttl, 2));
+  EXPECT_FALSE(memo.insert(1, "b", response, now, ttl, 2));
+  EXPECT_TRUE(memo.insert(2, "c", response, now, ttl, 2));
+  EXPECT_EQ(2U, memo.size());
+  EXPECT_EQ(nullptr, memo.lookup(1, "a", now));
+  EXPECT_EQ(response, memo.lookup(2, "c", now));
+
+  // connection closed: its entries are gone and a new one is watched
+  memo.eraseConnection(2);
+  EXPECT_EQ(1U, memo.size());
+  EXPECT_EQ(nullptr, memo.lookup(2, "c", now));
+  EXPECT_EQ(response, memo.lookup(1, "b", now));
+  EXPECT_TRUE(memo.insert(2, "c", response, now, ttl, 2));
+  memo.eraseConnection(1);
+  memo.eraseConnection(2);
+  EXPECT_EQ(0U, memo.size());
+}
+
+TEST_F(InjectFilterTest, RouteDisablesFilter) {
+  const std::string filter_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "x-da-trigger"}],
+    "cluster_name": "sessionCheck",
+    "stat_prefix": "sc",
+    "actions": [{ "result": ["ok"], "action": "passthrough" }]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  std::multimap<std::string, std::string> opaque_config{{"inject.sc.disabled", "true"}};
+  ON_CALL(mdcb_.route_->route_entry_, opaqueConfig()).WillByDefault(ReturnRef(opaque_config));
+
+  EXPECT_CALL(fac_ctx_.cluster_manager_.async_client_, start(_, _)).Times(0);
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/healthz"}, {"x-da-trigger", "1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, f.decodeHeaders(headers, true));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.sc.route_disabled").value());
+  EXPECT_EQ(0U, fac_ctx_.scope_.counter("test.inject.sc.triggered").value());
+}
+
+TEST_F(InjectFilterTest, RouteSelectsRouteConfig) {
+  const std::string filter_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "x-da-trigger"}],
+    "cluster_name": "sessionCheck",
+    "actions": [{ "result": ["ok"], "action": "passthrough" }],
+    "route_configs": {
+      "strict": {
+        "timeout_ms": 10,
+        "actions": [{ "result": ["ok"], "action": "abort", "response_code": 401 }]
+      }
+    }
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigSharedPtr base = Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_);
+  Http::InjectFilter f(base);
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  std::multimap<std::string, std::string> opaque_config{{"inject.config", "strict"}};
+  ON_CALL(mdcb_.route_->route_entry_, opaqueConfig()).WillByDefault(ReturnRef(opaque_config));
+
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}, {"x-da-trigger", "1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.route_config").value());
+  f.onSuccess(okResponse());
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.action_abort").value());
+  EXPECT_EQ(120, base->timeout_ms());
+  EXPECT_EQ("passthrough", base->action_matcher().match("ok").action_);
+}
+
+TEST_F(InjectFilterTest, RuntimeShedsPassthrough) {
+  const std::string filter_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "x-da-trigger"}],
+    "cluster_name": "sessionCheck",
+    "shed": {},
+    "actions": [{ "result": ["ok"], "action": "passthrough" }]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigSharedPtr c = Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_);
+
+  Http::InjectFilter f(c);
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  EXPECT_CALL(fac_ctx_.runtime_loader_.snapshot_, featureEnabled("inject.send_percent", 100)).WillOnce(Return(false));
+  EXPECT_CALL(fac_ctx_.cluster_manager_.async_client_, start(_, _)).Times(0);
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}, {"x-da-trigger", "1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::Continue, f.decodeHeaders(headers, true));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.shed").value());
+  EXPECT_EQ(0U, fac_ctx_.scope_.counter("test.inject.action_passthrough").value());
+  testing::Mock::VerifyAndClearExpectations(&fac_ctx_.cluster_manager_.async_client_);
+
+  Http::InjectFilter f2(c);
+  f2.setDecoderFilterCallbacks(mdcb_);
+  f2.setEncoderFilterCallbacks(mecb_);
+  EXPECT_CALL(fac_ctx_.runtime_loader_.snapshot_, featureEnabled("inject.send_percent", 100)).WillOnce(Return(true));
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers2{{":method", "GET"}, {":path", "/"}, {"x-da-trigger", "1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f2.decodeHeaders(headers2, true));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.shed").value());
+  f2.onDestroy();
+}
+
+TEST_F(InjectFilterTest, RuntimeShedsToErrorAction) {
+  const std::string filter_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "x-da-trigger"}],
+    "cluster_name": "sessionCheck",
+    "stat_prefix": "sc",
+    "shed": { "runtime_key": "inject.sc.rpc_percent", "default_send_percent": 50, "action": "error" },
+    "actions": [
+      { "result": ["ok"], "action": "passthrough" },
+      { "result": ["local.error"], "action": "abort", "response_code": 503 }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilter f(Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_));
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  EXPECT_CALL(fac_ctx_.runtime_loader_.snapshot_, featureEnabled("inject.sc.rpc_percent", 50)).WillOnce(Return(false));
+  EXPECT_CALL(fac_ctx_.cluster_manager_.async_client_, start(_, _)).Times(0);
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}, {"x-da-trigger", "1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.sc.shed").value());
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.sc.action_abort").value());
+}
+
+TEST_F(InjectFilterTest, ConcurrencyLimitErrorAction) {
+  const std::string filter_config = R"EOF(
+  {
+    "trigger_headers": [{ "name": "x-da-trigger"}],
+    "cluster_name": "sessionCheck",
+    "concurrency_limit": { "initial_limit": 1 },
+    "actions": [
+      { "result": ["ok"], "action": "passthrough" },
+      { "result": ["local.error"], "action": "abort", "response_code": 503 }
+    ]
+  }
+  )EOF";
+  Json::ObjectSharedPtr config = Json::Factory::loadFromString(filter_config);
+  Http::InjectFilterConfigProviderSharedPtr provider(new Http::InjectFilterConfigProvider(
+      fac_ctx_.thread_local_, Server::Configuration::InjectFilterConfig::createConfig(*config, "test.", fac_ctx_)));
+
+  Http::InjectFilter f(provider->config(), provider->workerState());
+  f.setDecoderFilterCallbacks(mdcb_);
+  f.setEncoderFilterCallbacks(mecb_);
+  expectInjectRequestSent();
+  Http::TestHeaderMapImpl headers{{":method", "GET"}, {":path", "/"}, {"x-da-trigger", "1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f.decodeHeaders(headers, true));
+  testing::Mock::VerifyAndClearExpectations(&fac_ctx_.cluster_manager_.async_client_);
+
+  // the one RPC allowed is outstanding
+  Http::InjectFilter f2(provider->config(), provider->workerState());
+  f2.setDecoderFilterCallbacks(mdcb_);
+  f2.setEncoderFilterCallbacks(mecb_);
+  EXPECT_CALL(fac_ctx_.cluster_manager_.async_client_, start(_, _)).Times(0);
+  Http::TestHeaderMapImpl headers2{{":method", "GET"}, {":path", "/"}, {"x-da-trigger", "1"}};
+  EXPECT_EQ(Http::FilterHeadersStatus::StopIteration, f2.decodeHeaders(headers2, true));
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.rpc_over_limit").value());
+  EXPECT_EQ(1U, fac_ctx_.scope_.counter("test.inject.action_abort").value());
+  EXPECT_EQ(1U, provider->workerState()->limiter_.limit());
+
+  f.onDestroy();
+  f2.onDestroy();
+}
+
+TEST_F(InjectFilterTest, ConcurrencyLimiterFollowsLatency) {
+  Http::InjectConcurrencyLimitConfig config{10, 2, 100, std::chrono::milliseconds(100), 5, 1.5,
+                                            Http::InjectConcurrencyLimitConfig::OverLimitAction::Error};
+  Http::InjectConcurrencyLimiter limiter;
+  EXPECT_TRUE(limiter.admit(9, config));
+  EXPECT_FALSE(limiter.admit(10, config));
+  EXPECT_EQ(10U, limiter.limit());
+
+  MonotonicTime now = std::chrono::steady_clock::now();
+  // one sample window of RPCs taking latency
+  auto window = [&](std::chrono::microseconds latency) {
+    limiter.record(latency, now, config);
+    now += std::chrono::milliseconds(100);
+    limiter.record(latency, now, config);
+    now += std::chrono::milliseconds(100);
+  };
+
+  // at the baseline the limit grows by sqrt(limit)
+  window(std::chrono::milliseconds(1));
+  EXPECT_EQ(13U, limiter.limit());
+
+  // a 10x slower injector drives it down
+  window(std::chrono::milliseconds(10));
+  EXPECT_EQ(10U, limiter.limit());
+  for (int i = 0; i < 7; i++) {
+    window(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(4U, limiter.limit());
+
+  // until the baseline is re-measured at the new speed
+  window(std::chrono::milliseconds(10));
+  EXPECT_EQ(6U, limiter.limit());
+  EXPECT_TRUE(limiter.admit(5, config));
+  EXPECT_FALSE(limiter.admit(6, config));
+}
+
 TEST_F(InjectFilterTest, CookieParserMiddle) {
   std::string c("geo=x; sessionId=939133-x9393; dnt=a314");
   InjectFilter::removeNamedCookie("sessionId", c);